@@ -0,0 +1,519 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Benchmarks for the parser hot paths, run on a host. Parses every
+ * telegram in the corpus with both the full field list from the
+ * examples and a minimal 3-field ParsedData (using P1Parser::parse,
+ * P1Parser::parse_verify_later and P1StreamParser), parses an archive
+ * of all telegrams with parse_batch, times receiving telegrams with
+ * P1Reader and times the CRC implementations. For each,
+ * reports time per telegram, throughput and heap allocations per
+ * telegram.
+ *
+ * Usage: dsmr_bench [min_ms_per_benchmark]
+ *
+ * Note that the host String shim is backed by std::string, which does
+ * not allocate for short strings, so allocation counts are a lower bound
+ * for what Arduino String does.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include "dsmr.h"
+#include "dsmr/batch.h"
+#include "dsmr/columns.h"
+#include "corpus.h"
+
+using namespace dsmr::bench;
+
+// Atomic, since the batch benchmark allocates from multiple threads
+static std::atomic<size_t> allocations(0);
+
+// Replace every plain new/delete variant, so all allocations are counted
+// and released with the matching function. These are kept out of line:
+// once inlined, GCC pairs the free() in delete with the new expression
+// and warns about a mismatched deallocation (-Wmismatched-new-delete).
+#define BENCH_NOINLINE __attribute__((noinline))
+
+BENCH_NOINLINE void *operator new(size_t n, const std::nothrow_t &) noexcept
+{
+  ++allocations;
+  return malloc(n ? n : 1);
+}
+BENCH_NOINLINE void *operator new(size_t n)
+{
+  void *p = operator new(n, std::nothrow);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+BENCH_NOINLINE void *operator new[](size_t n) { return operator new(n); }
+BENCH_NOINLINE void *operator new[](size_t n, const std::nothrow_t &) noexcept { return operator new(n, std::nothrow); }
+BENCH_NOINLINE void operator delete(void *p) noexcept { free(p); }
+BENCH_NOINLINE void operator delete[](void *p) noexcept { free(p); }
+BENCH_NOINLINE void operator delete(void *p, size_t) noexcept { free(p); }
+BENCH_NOINLINE void operator delete[](void *p, size_t) noexcept { free(p); }
+BENCH_NOINLINE void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+BENCH_NOINLINE void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+
+// Prevent the compiler from optimizing away the benchmarked work
+template <typename T>
+static inline void escape(T *p) { asm volatile("" : : "g"(p) : "memory"); }
+
+// The full list of fields from examples/parse
+using FullData = ParsedData<
+    /* String */ identification,
+    /* String */ p1_version,
+    /* String */ timestamp,
+    /* String */ equipment_id,
+    /* FixedValue */ energy_delivered_tariff1,
+    /* FixedValue */ energy_delivered_tariff2,
+    /* FixedValue */ energy_returned_tariff1,
+    /* FixedValue */ energy_returned_tariff2,
+    /* String */ electricity_tariff,
+    /* FixedValue */ power_delivered,
+    /* FixedValue */ power_returned,
+    /* FixedValue */ electricity_threshold,
+    /* uint8_t */ electricity_switch_position,
+    /* uint32_t */ electricity_failures,
+    /* uint32_t */ electricity_long_failures,
+    /* String */ electricity_failure_log,
+    /* uint32_t */ electricity_sags_l1,
+    /* uint32_t */ electricity_sags_l2,
+    /* uint32_t */ electricity_sags_l3,
+    /* uint32_t */ electricity_swells_l1,
+    /* uint32_t */ electricity_swells_l2,
+    /* uint32_t */ electricity_swells_l3,
+    /* String */ message_short,
+    /* String */ message_long,
+    /* FixedValue */ voltage_l1,
+    /* FixedValue */ voltage_l2,
+    /* FixedValue */ voltage_l3,
+    /* FixedValue */ current_l1,
+    /* FixedValue */ current_l2,
+    /* FixedValue */ current_l3,
+    /* FixedValue */ power_delivered_l1,
+    /* FixedValue */ power_delivered_l2,
+    /* FixedValue */ power_delivered_l3,
+    /* FixedValue */ power_returned_l1,
+    /* FixedValue */ power_returned_l2,
+    /* FixedValue */ power_returned_l3,
+    /* uint16_t */ gas_device_type,
+    /* String */ gas_equipment_id,
+    /* uint8_t */ gas_valve_position,
+    /* TimestampedFixedValue */ gas_delivered,
+    /* uint16_t */ thermal_device_type,
+    /* String */ thermal_equipment_id,
+    /* uint8_t */ thermal_valve_position,
+    /* TimestampedFixedValue */ thermal_delivered,
+    /* uint16_t */ water_device_type,
+    /* String */ water_equipment_id,
+    /* uint8_t */ water_valve_position,
+    /* TimestampedFixedValue */ water_delivered,
+    /* uint16_t */ sub_device_type,
+    /* String */ sub_equipment_id,
+    /* uint8_t */ sub_valve_position,
+    /* TimestampedFixedValue */ sub_delivered>;
+
+using MinimalData = ParsedData<
+    /* String */ identification,
+    /* FixedValue */ energy_delivered_tariff1,
+    /* FixedValue */ power_delivered>;
+
+static double min_ms = 200;
+
+/**
+ * Runs fn repeatedly for at least min_ms milliseconds and prints the
+ * time, throughput and allocations per call.
+ */
+template <typename Fn>
+static void measure(const char *group, const char *name, size_t bytes, Fn fn, size_t telegrams = 1)
+{
+  typedef std::chrono::steady_clock clock;
+
+  // Warm up, and make sure the benchmark actually works
+  fn();
+
+  size_t iterations = 0;
+  size_t allocs_before = allocations;
+  clock::time_point start = clock::now();
+  double elapsed_ns;
+  do
+  {
+    for (int i = 0; i < 64; ++i)
+      fn();
+    iterations += 64;
+    elapsed_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+  } while (elapsed_ns < min_ms * 1e6);
+  size_t allocs = allocations - allocs_before;
+
+  double ns = elapsed_ns / iterations;
+  printf("%-14s %-16s %6zu B %10.1f ns/telegram %9.1f MB/s %7.2f allocs/telegram\n",
+         group, name, bytes / telegrams, ns / telegrams, bytes / ns * 1e3,
+         (double)allocs / iterations / telegrams);
+}
+
+template <typename Data, bool verify_later = false>
+static void bench_parse(const char *group, const char *name, const std::string &telegram)
+{
+  const char *str = telegram.data();
+  size_t n = telegram.size();
+  measure(group, name, n, [str, n]() {
+    Data data;
+    ParseResult<void> res;
+    if (verify_later)
+      res = P1Parser::parse_verify_later(&data, str, n);
+    else
+      res = P1Parser::parse(&data, str, n);
+    if (res.err)
+    {
+      printf("Parse error:\n%s\n", res.fullError(str, str + n).c_str());
+      exit(1);
+    }
+    escape(&data);
+  });
+}
+
+#if DSMR_STRING_STORAGE != DSMR_STRING_VIEW
+template <typename Data>
+static void bench_stream(const char *group, const char *name, const std::string &telegram)
+{
+  const char *str = telegram.data();
+  size_t n = telegram.size();
+  // Big enough for message_long
+  P1StreamParser<Data, 2100> *parser = new P1StreamParser<Data, 2100>();
+  measure(group, name, n, [str, n, parser]() {
+    if (!parser->feed(str, n))
+    {
+      printf("Parse error:\n%s\n", parser->fullError().c_str());
+      exit(1);
+    }
+    escape(&parser->data());
+  });
+  delete parser;
+}
+#endif
+
+/**
+ * Stream that returns the same telegram over and over.
+ */
+class TelegramStream : public Stream
+{
+public:
+  TelegramStream(const std::string &telegram) : telegram(telegram), pos(0) {}
+
+  size_t write(uint8_t) override { return 1; }
+  int available() override { return telegram.size() - pos; }
+  int read() override { return pos < telegram.size() ? (uint8_t)telegram[pos++] : -1; }
+  int peek() override { return pos < telegram.size() ? (uint8_t)telegram[pos] : -1; }
+  size_t readBytes(char *buffer, size_t size) override
+  {
+    size_t n = std::min(size, telegram.size() - pos);
+    memcpy(buffer, telegram.data() + pos, n);
+    pos += n;
+    return n;
+  }
+
+  void rewind() { pos = 0; }
+
+protected:
+  const std::string &telegram;
+  size_t pos;
+};
+
+static void bench_reader(const char *group, const char *name, const std::string &telegram)
+{
+  TelegramStream *stream = new TelegramStream(telegram);
+  P1Reader *reader = new P1Reader(stream, 2);
+  reader->enable(false);
+  measure(group, name, telegram.size(), [stream, reader]() {
+    stream->rewind();
+    if (!reader->loop())
+    {
+      printf("Reader did not receive a message\n");
+      exit(1);
+    }
+    escape(&reader->raw());
+    reader->clear();
+  });
+  delete reader;
+  delete stream;
+}
+
+template <typename Data>
+static void bench_batch(const char *group, const char *name, const std::string &archive, size_t telegrams,
+                        unsigned threads)
+{
+  const char *str = archive.data();
+  size_t n = archive.size();
+  measure(group, name, n, [str, n, threads, telegrams]() {
+    std::vector<BatchResult<Data>> results = parse_batch<Data>(str, n, threads);
+    if (results.size() != telegrams || !results.back().ok())
+    {
+      printf("Batch parse failed\n");
+      exit(1);
+    }
+    escape(&results);
+  }, telegrams);
+}
+
+/**
+ * The NumParser from before it used SWAR and compiletime units, as a
+ * baseline for bench_num.
+ */
+struct StrchrNumParser
+{
+  static ParseResult<uint32_t> parse(size_t max_decimals, const char *unit, const char *str, const char *end)
+  {
+    ParseResult<uint32_t> res;
+    if (str >= end || *str != '(')
+      return res.fail(F("Missing ("), str);
+
+    const char *num_end = str + 1;
+    uint32_t value = 0;
+    while (num_end < end && !strchr("*.)", *num_end))
+    {
+      if (*num_end < '0' || *num_end > '9')
+        return res.fail(F("Invalid number"), num_end);
+      value = value * 10 + (*num_end++ - '0');
+    }
+    if (max_decimals && num_end < end && *num_end == '.')
+    {
+      ++num_end;
+      while (num_end < end && !strchr("*)", *num_end) && max_decimals--)
+      {
+        if (*num_end < '0' || *num_end > '9')
+          return res.fail(F("Invalid number"), num_end);
+        value = value * 10 + (*num_end++ - '0');
+      }
+    }
+    while (max_decimals--)
+      value *= 10;
+    if (unit && *unit)
+    {
+      if (num_end >= end || *num_end != '*')
+        return res.fail(F("Missing unit"), num_end);
+      const char *unit_start = ++num_end;
+      while (num_end < end && *num_end != ')' && *unit)
+      {
+        if (*num_end++ != *unit++)
+          return res.fail(F("Invalid unit"), unit_start);
+      }
+      if (*unit)
+        return res.fail(F("Invalid unit"), unit_start);
+    }
+    if (num_end >= end || *num_end != ')')
+      return res.fail(F("Extra data"), num_end);
+    return res.succeed(value).until(num_end + 1);
+  }
+};
+
+/**
+ * Typical values from the corpus, with the decimals and unit of their
+ * field, and the NumParser for those at compiletime.
+ */
+struct NumSample
+{
+  const char *str;
+  size_t decimals;
+  const char *unit;
+  ParseResult<uint32_t> (*parse)(const char *, const char *);
+};
+
+static const NumSample num_samples[] = {
+    {"(000842.472*kWh)", 3, fields::units::kWh, &NumParser::parse<3, fields::units::kWh>},
+    {"(123456.789*kWh)", 3, fields::units::kWh, &NumParser::parse<3, fields::units::kWh>},
+    {"(00.210*kW)", 3, fields::units::kW, &NumParser::parse<3, fields::units::kW>},
+    {"(01.193*kW)", 3, fields::units::kW, &NumParser::parse<3, fields::units::kW>},
+    {"(220.1*V)", 3, fields::units::V, &NumParser::parse<3, fields::units::V>},
+    {"(001*A)", 0, fields::units::A, &NumParser::parse<0, fields::units::A>},
+    {"(00473.789*m3)", 3, fields::units::m3, &NumParser::parse<3, fields::units::m3>},
+    {"(0000000021)", 0, fields::units::none, &NumParser::parse<0, fields::units::none>},
+};
+
+/**
+ * Parses all num_samples with the given parser, which is called with a
+ * NumSample and the end of its str.
+ */
+template <typename Parse>
+static void bench_num(const char *group, const char *name, Parse parse)
+{
+  const size_t count = sizeof(num_samples) / sizeof(*num_samples);
+  size_t bytes = 0;
+  const char *ends[count];
+  for (size_t i = 0; i < count; ++i)
+  {
+    ends[i] = num_samples[i].str + strlen(num_samples[i].str);
+    bytes += ends[i] - num_samples[i].str;
+    ParseResult<uint32_t> res = parse(num_samples[i], ends[i]);
+    if (res.err || res.next != ends[i] || res.result != StrchrNumParser::parse(num_samples[i].decimals, num_samples[i].unit, num_samples[i].str, ends[i]).result)
+    {
+      printf("Number mismatch for %s on %s\n", name, num_samples[i].str);
+      exit(1);
+    }
+  }
+  measure(group, name, bytes, [parse, &ends, count]() {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < count; ++i)
+      sum += parse(num_samples[i], ends[i]).result;
+    escape(&sum);
+  }, count);
+}
+
+/**
+ * Compares min/max/sum of voltage_l1 over a series of parsed telegrams,
+ * stored as rows (ParsedData) and as columns.
+ */
+static void bench_columns(const char *group, const std::string &archive, size_t telegrams)
+{
+  std::vector<BatchResult<FullData>> rows = parse_batch<FullData>(archive.data(), archive.size());
+  TelegramColumns<FullData> *columns = new TelegramColumns<FullData>();
+  columns->reserve(rows.size());
+  for (BatchResult<FullData> &row : rows)
+    columns->append(row.data);
+
+  measure(group, "rows", telegrams * sizeof(uint32_t), [&rows]() {
+    ColumnStats<uint32_t> res = {0, 0xffffffff, 0, 0};
+    for (BatchResult<FullData> &row : rows)
+    {
+      if (!row.data.present<voltage_l1>())
+        continue;
+      uint32_t v = row.data.voltage_l1._value;
+      res.min = std::min(res.min, v);
+      res.max = std::max(res.max, v);
+      res.sum += v;
+      res.count++;
+    }
+    escape(&res);
+  }, telegrams);
+  measure(group, "columns", telegrams * sizeof(uint32_t), [columns]() {
+    ColumnStats<uint32_t> res = columns->stats<voltage_l1>();
+    escape(&res);
+  }, telegrams);
+  delete columns;
+}
+
+template <uint16_t (*update)(uint16_t, const char *, size_t)>
+static void bench_crc(const char *group, const char *name, const std::string &telegram)
+{
+  const char *str = telegram.data();
+  size_t n = telegram.size();
+  if (update(0, str, n) != _crc16_update_bitwise(0, str, n))
+  {
+    printf("CRC mismatch for %s on %s\n", group, name);
+    exit(1);
+  }
+  measure(group, name, n, [str, n]() {
+    uint16_t crc = update(0, str, n);
+    escape(&crc);
+  });
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    min_ms = atof(argv[1]);
+
+  std::vector<std::string> telegrams;
+  for (const CorpusEntry &entry : corpus)
+    telegrams.push_back(make_telegram(entry.body));
+
+  for (size_t i = 0; i < telegrams.size(); ++i)
+  {
+    bench_parse<FullData>("parse/full", corpus[i].name, telegrams[i]);
+    bench_parse<MinimalData>("parse/minimal", corpus[i].name, telegrams[i]);
+  }
+
+  bench_num("num", "strchr", [](const NumSample &s, const char *end) {
+    return StrchrNumParser::parse(s.decimals, s.unit, s.str, end);
+  });
+  bench_num("num", "runtime unit", [](const NumSample &s, const char *end) {
+    return NumParser::parse(s.decimals, s.unit, s.str, end);
+  });
+  bench_num("num", "compiletime", [](const NumSample &s, const char *end) {
+    return s.parse(s.str, end);
+  });
+
+  for (size_t i = 0; i < telegrams.size(); ++i)
+  {
+    bench_parse<FullData, true>("verify/full", corpus[i].name, telegrams[i]);
+    bench_parse<MinimalData, true>("verify/minimal", corpus[i].name, telegrams[i]);
+  }
+
+#if DSMR_STRING_STORAGE != DSMR_STRING_VIEW
+  for (size_t i = 0; i < telegrams.size(); ++i)
+  {
+    bench_stream<FullData>("stream/full", corpus[i].name, telegrams[i]);
+    bench_stream<MinimalData>("stream/minimal", corpus[i].name, telegrams[i]);
+  }
+#else
+  // P1StreamParser reuses its buffer, so it cannot use view strings
+  printf("stream/*: skipped, P1StreamParser does not support DSMR_STRING_VIEW\n");
+#endif
+
+  // An archive with all telegrams in the corpus, repeated
+  std::string archive;
+  size_t archive_telegrams = 0;
+  while (archive_telegrams < 4096)
+  {
+    for (const std::string &telegram : telegrams)
+      archive += telegram;
+    archive_telegrams += telegrams.size();
+  }
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  char cores_name[32];
+  snprintf(cores_name, sizeof(cores_name), "%u threads", cores);
+  bench_batch<FullData>("batch/full", "1 thread", archive, archive_telegrams, 1);
+  if (cores > 1)
+    bench_batch<FullData>("batch/full", cores_name, archive, archive_telegrams, cores);
+
+  bench_columns("columns/stats", archive, archive_telegrams);
+
+  for (size_t i = 0; i < telegrams.size(); ++i)
+    bench_reader("reader/raw", corpus[i].name, telegrams[i]);
+
+  for (size_t i = 0; i < telegrams.size(); ++i)
+  {
+    bench_crc<_crc16_update_bitwise>("crc/bitwise", corpus[i].name, telegrams[i]);
+    bench_crc<_crc16_update_table>("crc/table", corpus[i].name, telegrams[i]);
+#if DSMR_CRC16_IMPL >= DSMR_CRC16_SLICE8
+    bench_crc<_crc16_update_slice8>("crc/slice8", corpus[i].name, telegrams[i]);
+#endif
+#if DSMR_CRC16_IMPL == DSMR_CRC16_CLMUL
+    bench_crc<_crc16_update_clmul>("crc/clmul", corpus[i].name, telegrams[i]);
+#endif
+  }
+
+  return 0;
+}
@@ -0,0 +1,246 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Telegram corpus for the benchmarks. Each telegram is stored up to and
+ * including the terminating !, the checksum is computed and appended
+ * at startup (see make_telegram()), so the bodies can be edited freely.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "dsmr/crc16.h"
+
+namespace dsmr
+{
+  namespace bench
+  {
+
+    struct CorpusEntry
+    {
+      const char *name;
+      const char *body;
+    };
+
+    // The example telegram from examples/parse (DSMR 4.0)
+    static const char KFM5KAIFA[] =
+        "/KFM5KAIFA-METER\r\n"
+        "\r\n"
+        "1-3:0.2.8(40)\r\n"
+        "0-0:1.0.0(150117185916W)\r\n"
+        "0-0:96.1.1(0000000000000000000000000000000000)\r\n"
+        "1-0:1.8.1(000671.578*kWh)\r\n"
+        "1-0:1.8.2(000842.472*kWh)\r\n"
+        "1-0:2.8.1(000000.000*kWh)\r\n"
+        "1-0:2.8.2(000000.000*kWh)\r\n"
+        "0-0:96.14.0(0001)\r\n"
+        "1-0:1.7.0(00.333*kW)\r\n"
+        "1-0:2.7.0(00.000*kW)\r\n"
+        "0-0:17.0.0(999.9*kW)\r\n"
+        "0-0:96.3.10(1)\r\n"
+        "0-0:96.7.21(00008)\r\n"
+        "0-0:96.7.9(00007)\r\n"
+        "1-0:99.97.0(1)(0-0:96.7.19)(000101000001W)(2147483647*s)\r\n"
+        "1-0:32.32.0(00000)\r\n"
+        "1-0:32.36.0(00000)\r\n"
+        "0-0:96.13.1()\r\n"
+        "0-0:96.13.0()\r\n"
+        "1-0:31.7.0(001*A)\r\n"
+        "1-0:21.7.0(00.332*kW)\r\n"
+        "1-0:22.7.0(00.000*kW)\r\n"
+        "0-1:24.1.0(003)\r\n"
+        "0-1:96.1.0(0000000000000000000000000000000000)\r\n"
+        "0-1:24.2.1(150117180000W)(00473.789*m3)\r\n"
+        "0-1:24.4.0(1)\r\n"
+        "!";
+
+    // DSMR 5.0 three-phase meter with a gas meter
+    static const char DSMR50_3PHASE[] =
+        "/ISk5\\2MT382-1000\r\n"
+        "\r\n"
+        "1-3:0.2.8(50)\r\n"
+        "0-0:1.0.0(101209113020W)\r\n"
+        "0-0:96.1.1(4B384547303034303436333935353037)\r\n"
+        "1-0:1.8.1(123456.789*kWh)\r\n"
+        "1-0:1.8.2(123456.789*kWh)\r\n"
+        "1-0:2.8.1(123456.789*kWh)\r\n"
+        "1-0:2.8.2(123456.789*kWh)\r\n"
+        "0-0:96.14.0(0002)\r\n"
+        "1-0:1.7.0(01.193*kW)\r\n"
+        "1-0:2.7.0(00.000*kW)\r\n"
+        "0-0:96.7.21(00004)\r\n"
+        "0-0:96.7.9(00002)\r\n"
+        "1-0:99.97.0(2)(0-0:96.7.19)(101208152415W)(0000000240*s)(101208151004W)(0000000301*s)\r\n"
+        "1-0:32.32.0(00002)\r\n"
+        "1-0:52.32.0(00001)\r\n"
+        "1-0:72.32.0(00000)\r\n"
+        "1-0:32.36.0(00000)\r\n"
+        "1-0:52.36.0(00003)\r\n"
+        "1-0:72.36.0(00000)\r\n"
+        "0-0:96.13.0(303132333435363738393A3B3C3D3E3F303132333435363738393A3B3C3D3E3F)\r\n"
+        "1-0:32.7.0(220.1*V)\r\n"
+        "1-0:52.7.0(220.2*V)\r\n"
+        "1-0:72.7.0(220.3*V)\r\n"
+        "1-0:31.7.0(001*A)\r\n"
+        "1-0:51.7.0(002*A)\r\n"
+        "1-0:71.7.0(003*A)\r\n"
+        "1-0:21.7.0(01.111*kW)\r\n"
+        "1-0:41.7.0(02.222*kW)\r\n"
+        "1-0:61.7.0(03.333*kW)\r\n"
+        "1-0:22.7.0(04.444*kW)\r\n"
+        "1-0:42.7.0(05.555*kW)\r\n"
+        "1-0:62.7.0(06.666*kW)\r\n"
+        "0-1:24.1.0(003)\r\n"
+        "0-1:96.1.0(3232323241424344313233343536373839)\r\n"
+        "0-1:24.2.1(101209112500W)(12785.123*m3)\r\n"
+        "!";
+
+    // Belgian (Fluvius) meter, using p1_version_be and gas_delivered_be
+    static const char BELGIUM[] =
+        "/FLU5\\253769484_A\r\n"
+        "\r\n"
+        "0-0:96.1.4(50217)\r\n"
+        "0-0:96.1.1(3153414733313031303231363035)\r\n"
+        "0-0:1.0.0(200512135409S)\r\n"
+        "1-0:1.8.1(000000.034*kWh)\r\n"
+        "1-0:1.8.2(000015.758*kWh)\r\n"
+        "1-0:2.8.1(000000.000*kWh)\r\n"
+        "1-0:2.8.2(000000.011*kWh)\r\n"
+        "1-0:1.4.0(02.351*kW)\r\n"
+        "1-0:1.6.0(200509134558S)(02.589*kW)\r\n"
+        "0-0:98.1.0(3)(1-0:1.6.0)(1-0:1.6.0)(200501000000S)(200423192538S)(03.695*kW)(200401000000S)(200305122139S)(05.980*kW)(200301000000S)(200210035421W)(04.318*kW)\r\n"
+        "0-0:96.14.0(0001)\r\n"
+        "1-0:1.7.0(00.000*kW)\r\n"
+        "1-0:2.7.0(00.000*kW)\r\n"
+        "1-0:21.7.0(00.000*kW)\r\n"
+        "1-0:22.7.0(00.000*kW)\r\n"
+        "1-0:32.7.0(234.7*V)\r\n"
+        "1-0:31.7.0(000*A)\r\n"
+        "0-0:96.3.10(1)\r\n"
+        "0-0:17.0.0(999.9*kW)\r\n"
+        "0-0:96.13.0()\r\n"
+        "0-1:24.1.0(003)\r\n"
+        "0-1:96.1.1(37464C4F32313139303333373333)\r\n"
+        "0-1:24.4.0(1)\r\n"
+        "0-1:24.2.3(200512134558S)(00112.384*m3)\r\n"
+        "!";
+
+    // Luxembourg (Smarty) meter, using the _lux and reactive fields
+    static const char LUXEMBOURG[] =
+        "/Lux5\\253668708_D\r\n"
+        "\r\n"
+        "1-3:0.2.8(42)\r\n"
+        "0-0:1.0.0(200512135409S)\r\n"
+        "0-0:42.0.0(53414731303330303136343539303032)\r\n"
+        "1-0:1.8.0(000123.456*kWh)\r\n"
+        "1-0:2.8.0(000000.000*kWh)\r\n"
+        "1-0:3.8.0(000012.345*kvarh)\r\n"
+        "1-0:4.8.0(000045.678*kvarh)\r\n"
+        "1-0:1.7.0(00.210*kW)\r\n"
+        "1-0:2.7.0(00.000*kW)\r\n"
+        "1-0:3.7.0(00.000*kvar)\r\n"
+        "1-0:4.7.0(00.062*kvar)\r\n"
+        "0-0:96.3.10(1)\r\n"
+        "0-0:96.7.21(00003)\r\n"
+        "1-0:32.32.0(00001)\r\n"
+        "1-0:32.36.0(00000)\r\n"
+        "0-0:96.13.0()\r\n"
+        "1-0:32.7.0(230.1*V)\r\n"
+        "1-0:31.7.0(001*A)\r\n"
+        "1-0:21.7.0(00.210*kW)\r\n"
+        "1-0:22.7.0(00.000*kW)\r\n"
+        "!";
+
+    // DSMR 5.0 single-phase meter with a maximum length (2048 char) text
+    // message
+    static const char MESSAGE_LONG[] =
+        "/ISk5\\2MT382-1000\r\n"
+        "\r\n"
+        "1-3:0.2.8(50)\r\n"
+        "0-0:1.0.0(101209113020W)\r\n"
+        "0-0:96.1.1(4B384547303034303436333935353037)\r\n"
+        "1-0:1.8.1(123456.789*kWh)\r\n"
+        "1-0:1.8.2(123456.789*kWh)\r\n"
+        "1-0:2.8.1(123456.789*kWh)\r\n"
+        "1-0:2.8.2(123456.789*kWh)\r\n"
+        "0-0:96.14.0(0002)\r\n"
+        "1-0:1.7.0(01.193*kW)\r\n"
+        "1-0:2.7.0(00.000*kW)\r\n"
+        "0-0:96.13.0(303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+        "606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F"
+        "505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F"
+        "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F"
+        "303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+        "606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F"
+        "505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F"
+        "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F"
+        "303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+        "606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F"
+        "505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F"
+        "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F"
+        "303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+        "606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F"
+        "505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F"
+        "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F"
+        "303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+        "606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F"
+        "505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F303132333435363738393A3B3C3D3E3F"
+        "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F"
+        "303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+        "606162636465666768696A6B6C6D6E6F)\r\n"
+        "1-0:32.7.0(220.1*V)\r\n"
+        "1-0:31.7.0(001*A)\r\n"
+        "1-0:21.7.0(01.111*kW)\r\n"
+        "1-0:22.7.0(00.000*kW)\r\n"
+        "!";
+
+    static const CorpusEntry corpus[] = {
+        {"kfm5kaifa", KFM5KAIFA},
+        {"dsmr50_3phase", DSMR50_3PHASE},
+        {"belgium", BELGIUM},
+        {"luxembourg", LUXEMBOURG},
+        {"message_long", MESSAGE_LONG},
+    };
+
+    /**
+     * Returns the complete telegram for the given body: the body followed
+     * by its checksum and CRLF.
+     */
+    inline std::string make_telegram(const char *body)
+    {
+      std::string res(body);
+      char crc[5];
+      snprintf(crc, sizeof(crc), "%04X", crc16_update(0, res.data(), res.size()));
+      res += crc;
+      res += "\r\n";
+      return res;
+    }
+
+  } // namespace bench
+} // namespace dsmr
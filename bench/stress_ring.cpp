@@ -0,0 +1,214 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Stress test for SpscRing, run on a host with two threads.
+ *
+ * The first test floods a small ring with the telegram corpus as fast
+ * as possible, in random chunk sizes on both sides, and checks that
+ * the consumer receives every byte in order.
+ *
+ * The second test simulates a UART at the given baud rate (8N1, so 10
+ * bits per byte): the producer thread pushes the bytes of the telegrams
+ * as they would arrive, in small bursts like a UART FIFO interrupt
+ * does, and the consumer thread runs a P1Reader on the ring. It checks
+ * that every telegram is received correctly and reports how long after
+ * its last byte arrived the reader had it complete.
+ *
+ * Usage: dsmr_stress_ring [telegrams] [baud]
+ *
+ * Exits with status 1 when bytes were lost or corrupted.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "dsmr.h"
+#include "dsmr/ring.h"
+#include "corpus.h"
+
+using namespace dsmr::bench;
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_us(Clock::time_point since, Clock::time_point until)
+{
+  return std::chrono::duration<double, std::micro>(until - since).count();
+}
+
+static bool stress_flood(const std::string &archive, size_t rounds)
+{
+  SpscRing<256> ring;
+  const uint8_t *data = (const uint8_t *)archive.data();
+  size_t total = archive.size() * rounds;
+
+  Clock::time_point start = Clock::now();
+  std::thread producer([&]() {
+    std::mt19937 rng(1);
+    for (size_t r = 0; r < rounds; ++r)
+    {
+      size_t pos = 0;
+      while (pos < archive.size())
+      {
+        size_t n = std::min<size_t>(1 + rng() % 100, archive.size() - pos);
+        // Wait for room instead of dropping, this test is about
+        // corruption, not overflows
+        n = std::min(n, ring.room());
+        if (!n)
+          std::this_thread::yield();
+        pos += ring.push(data + pos, n);
+      }
+    }
+  });
+
+  std::mt19937 rng(2);
+  char buf[128];
+  size_t received = 0, mismatches = 0;
+  while (received < total)
+  {
+    size_t n = ring.drain(buf, 1 + rng() % sizeof(buf));
+    if (!n)
+      std::this_thread::yield();
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (buf[i] != archive[(received + i) % archive.size()])
+        ++mismatches;
+    }
+    received += n;
+  }
+  producer.join();
+  double us = elapsed_us(start, Clock::now());
+
+  printf("flood: %zu bytes in %.1f ms (%.1f MB/s), %zu mismatches, %u overflows\n", received, us / 1000,
+         received / us, mismatches, ring.overflows());
+  return mismatches == 0 && ring.overflows() == 0;
+}
+
+static bool stress_uart(const std::vector<std::string> &telegrams, unsigned long baud)
+{
+  // Large enough for the bytes that arrive while the consumer is busy
+  // for a few ms
+  SpscRing<1024> ring;
+  P1Reader reader(&ring, 2);
+  reader.enable(false);
+
+  // The time the last checksum byte of each telegram was pushed,
+  // written by the producer before pushing that byte, so the consumer
+  // sees it once it has the byte
+  std::vector<Clock::time_point> sent(telegrams.size());
+
+  const double bytes_per_us = baud / 10.0 / 1e6;
+  // Push every 16 bytes, like a UART RX FIFO threshold
+  const size_t burst = 16;
+
+  Clock::time_point start = Clock::now();
+  std::thread producer([&]() {
+    double due = 0;
+    for (size_t t = 0; t < telegrams.size(); ++t)
+    {
+      const std::string &telegram = telegrams[t];
+      for (size_t pos = 0; pos < telegram.size();)
+      {
+        size_t n = std::min(burst, telegram.size() - pos);
+        due += n / bytes_per_us;
+        std::this_thread::sleep_until(start + std::chrono::microseconds((long)due));
+        // The telegrams end with CRLF, which the reader does not wait for
+        size_t last = telegram.size() - 3;
+        if (pos <= last && last < pos + n)
+          sent[t] = Clock::now();
+        ring.push((const uint8_t *)telegram.data() + pos, n);
+        pos += n;
+      }
+    }
+  });
+
+  size_t received = 0, corrupt = 0;
+  double latency_sum = 0, latency_max = 0;
+  std::vector<double> latencies;
+  Clock::time_point deadline = start + std::chrono::seconds(5);
+  while (received < telegrams.size())
+  {
+    if (reader.loop())
+    {
+      Clock::time_point now = Clock::now();
+      double latency = elapsed_us(sent[received], now);
+      latencies.push_back(latency);
+      latency_sum += latency;
+      latency_max = std::max(latency_max, latency);
+
+      const std::string &telegram = telegrams[received];
+      size_t body = telegram.find('!') - 1;
+      const String &raw = reader.raw();
+      if (raw.length() != body || memcmp(raw.c_str(), telegram.data() + 1, body) != 0)
+        ++corrupt;
+      reader.clear();
+      ++received;
+      deadline = now + std::chrono::seconds(5);
+    }
+    else if (Clock::now() > deadline)
+    {
+      break;
+    }
+    else
+    {
+      // Other work in the consumer's loop
+      std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+  }
+  producer.join();
+
+  std::sort(latencies.begin(), latencies.end());
+  printf("uart %lu baud: %zu/%zu telegrams in %.1f ms, %zu corrupt, %u overflows\n", baud, received,
+         telegrams.size(), elapsed_us(start, Clock::now()) / 1000, corrupt, ring.overflows());
+  if (!latencies.empty())
+    printf("latency after the checksum arrived: avg %.0f us, median %.0f us, max %.0f us\n", latency_sum / latencies.size(),
+           latencies[latencies.size() / 2], latency_max);
+  return received == telegrams.size() && corrupt == 0 && ring.overflows() == 0;
+}
+
+int main(int argc, char **argv)
+{
+  size_t count = argc > 1 ? atoi(argv[1]) : 20;
+  unsigned long baud = argc > 2 ? atol(argv[2]) : 115200;
+
+  std::vector<std::string> telegrams;
+  std::string archive;
+  for (size_t i = 0; i < count; ++i)
+  {
+    telegrams.push_back(make_telegram(corpus[i % lengthof(corpus)].body));
+    archive += telegrams.back();
+  }
+
+  bool ok = stress_flood(archive, 200);
+  ok = stress_uart(telegrams, baud) && ok;
+  return ok ? 0 : 1;
+}
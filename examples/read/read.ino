@@ -78,9 +78,9 @@ using MyData = ParsedData<
  *
  * When passed an instance of this Printer object, applyEach will loop
  * over each field and call Printer::apply, passing a reference to each
- * field in turn. This passes the actual field object, not the field
- * value, so each call to Printer::apply will have a differently typed
- * parameter.
+ * field in turn, along with whether the field is present. This passes
+ * the actual field object, not the field value, so each call to
+ * Printer::apply will have a differently typed parameter.
  *
  * For this reason, Printer::apply is a template, resulting in one
  * distinct apply method for each field used. This allows looking up
@@ -94,9 +94,9 @@ using MyData = ParsedData<
 struct Printer
 {
   template <typename Item>
-  void apply(Item &i)
+  void apply(Item &i, bool present)
   {
-    if (i.present())
+    if (present)
     {
       Serial.print(Item::name);
       Serial.print(F(": "));
@@ -149,16 +149,16 @@ void loop()
   if (reader.available())
   {
     MyData data;
-    String err;
-    if (reader.parse(&data, &err))
+    if (reader.parse(&data, Serial))
     {
       // Parse succesful, print result
       data.applyEach(Printer());
     }
     else
     {
-      // Parser error, print error
-      Serial.println(err);
+      // Parser error, which was already printed to Serial (this does not
+      // allocate a String for it)
+      Serial.println();
     }
   }
 }
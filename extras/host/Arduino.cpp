@@ -0,0 +1,100 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Host implementations for the Arduino compatibility shim.
+ */
+
+#include "Arduino.h"
+
+#include <chrono>
+#include <thread>
+
+HostSerial Serial;
+
+static std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+unsigned long micros()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+String::String(unsigned long v, unsigned char base)
+{
+  char buf[8 * sizeof(v) + 1];
+  snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", v);
+  s = buf;
+}
+
+size_t Print::print(long v, int base)
+{
+  if (base == DEC && v < 0)
+    return print('-') + print(0UL - (unsigned long)v, base);
+  return print((unsigned long)v, base);
+}
+
+size_t Print::print(unsigned long v, int base)
+{
+  char buf[8 * sizeof(v) + 1];
+  snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", v);
+  return write(buf);
+}
+
+size_t Print::print(double v, int digits)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, v);
+  return write(buf);
+}
+
+size_t Stream::readBytes(char *buffer, size_t size)
+{
+  size_t count = 0;
+  unsigned long start = millis();
+  while (count < size)
+  {
+    int c = read();
+    if (c < 0)
+    {
+      if (millis() - start >= _timeout)
+        break;
+      yield();
+      continue;
+    }
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
@@ -0,0 +1,255 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Minimal Arduino compatibility shim for building the library on a
+ * (Linux) host. This is only put on the include path by the dsmr_host
+ * CMake target, so the library headers can keep including <Arduino.h>
+ * unchanged. Only the parts of the Arduino API that the library and
+ * its examples use are provided.
+ */
+
+#ifndef DSMR_HOST_ARDUINO_H
+#define DSMR_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+
+// Program memory is just normal memory on a host
+#define PROGMEM
+#define PGM_P const char *
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define LOW 0x0
+#define HIGH 0x1
+
+#define DEC 10
+#define HEX 16
+
+inline void pinMode(uint8_t /* pin */, uint8_t /* mode */) {}
+inline void digitalWrite(uint8_t /* pin */, uint8_t /* val */) {}
+inline int digitalRead(uint8_t /* pin */) { return LOW; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void yield() {}
+
+/**
+ * Subset of the Arduino String class, backed by std::string.
+ */
+class String
+{
+public:
+  String() {}
+  String(const char *s) : s(s ? s : "") {}
+  String(const __FlashStringHelper *s) : s(reinterpret_cast<const char *>(s)) {}
+  String(char c) : s(1, c) {}
+  explicit String(unsigned long v, unsigned char base = DEC);
+
+  unsigned char reserve(unsigned int size)
+  {
+    s.reserve(size);
+    return 1;
+  }
+  unsigned int length() const { return s.length(); }
+  const char *c_str() const { return s.c_str(); }
+
+  unsigned char concat(const String &other)
+  {
+    s += other.s;
+    return 1;
+  }
+  unsigned char concat(const char *cstr)
+  {
+    if (!cstr)
+      return 0;
+    s += cstr;
+    return 1;
+  }
+  unsigned char concat(const char *cstr, unsigned int len)
+  {
+    if (!cstr)
+      return 0;
+    s.append(cstr, len);
+    return 1;
+  }
+  unsigned char concat(const __FlashStringHelper *str) { return concat(reinterpret_cast<const char *>(str)); }
+  unsigned char concat(char c)
+  {
+    s += c;
+    return 1;
+  }
+
+  String &operator+=(const String &rhs)
+  {
+    concat(rhs);
+    return *this;
+  }
+  String &operator+=(const char *rhs)
+  {
+    concat(rhs);
+    return *this;
+  }
+  String &operator+=(const __FlashStringHelper *rhs)
+  {
+    concat(rhs);
+    return *this;
+  }
+  String &operator+=(char rhs)
+  {
+    concat(rhs);
+    return *this;
+  }
+
+  void remove(unsigned int index)
+  {
+    if (index < s.length())
+      s.erase(index);
+  }
+  void remove(unsigned int index, unsigned int count)
+  {
+    if (index < s.length())
+      s.erase(index, count);
+  }
+
+  char operator[](unsigned int index) const { return index < s.length() ? s[index] : 0; }
+  bool operator==(const String &rhs) const { return s == rhs.s; }
+  bool operator==(const char *rhs) const { return s == rhs; }
+  bool operator!=(const String &rhs) const { return s != rhs.s; }
+  bool operator!=(const char *rhs) const { return s != rhs; }
+
+private:
+  std::string s;
+};
+
+class Print;
+
+/**
+ * Interface for objects that know how to print themselves.
+ */
+class Printable
+{
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print &p) const = 0;
+};
+
+/**
+ * Output base class, like the Arduino Print class.
+ */
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t n = 0;
+    while (size--)
+      n += write(*buffer++);
+    return n;
+  }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  size_t write(const char *str) { return str ? write(str, strlen(str)) : 0; }
+
+  size_t print(const __FlashStringHelper *s) { return write(reinterpret_cast<const char *>(s)); }
+  size_t print(const String &s) { return write(s.c_str(), s.length()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC);
+  size_t print(unsigned long v, int base = DEC);
+  size_t print(double v, int digits = 2);
+  size_t print(const Printable &x) { return x.printTo(*this); }
+
+  size_t println() { return write("\r\n"); }
+  size_t println(const __FlashStringHelper *s) { return print(s) + println(); }
+  size_t println(const String &s) { return print(s) + println(); }
+  size_t println(const char *s) { return print(s) + println(); }
+  size_t println(char c) { return print(c) + println(); }
+  size_t println(unsigned char v, int base = DEC) { return print(v, base) + println(); }
+  size_t println(int v, int base = DEC) { return print(v, base) + println(); }
+  size_t println(unsigned int v, int base = DEC) { return print(v, base) + println(); }
+  size_t println(long v, int base = DEC) { return print(v, base) + println(); }
+  size_t println(unsigned long v, int base = DEC) { return print(v, base) + println(); }
+  size_t println(double v, int digits = 2) { return print(v, digits) + println(); }
+  size_t println(const Printable &x) { return print(x) + println(); }
+};
+
+/**
+ * Input base class, like the Arduino Stream class.
+ */
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+
+  // Reads characters into buffer, until size bytes were read or the
+  // timeout expires.
+  virtual size_t readBytes(char *buffer, size_t size);
+  size_t readBytes(uint8_t *buffer, size_t size) { return readBytes((char *)buffer, size); }
+
+protected:
+  unsigned long _timeout = 1000;
+};
+
+/**
+ * Serial port stand-in that writes to stdout and never has data to
+ * read.
+ */
+class HostSerial : public Stream
+{
+public:
+  void begin(unsigned long /* baud */) {}
+  size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+
+extern HostSerial Serial;
+
+#endif // DSMR_HOST_ARDUINO_H
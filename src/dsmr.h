@@ -34,7 +34,9 @@
 
 #include "dsmr/parser.h"
 #include "dsmr/reader.h"
+#include "dsmr/stream_parser.h"
 #include "dsmr/fields.h"
+#include "dsmr/serialize.h"
 
 // Allow using everything without the namespace prefixes
 using namespace dsmr;
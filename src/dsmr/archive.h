@@ -0,0 +1,419 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Random access to raw P1 capture files, using a memory mapping of the
+ * file and an index of the telegrams in it, sorted by their timestamp.
+ * This needs POSIX (mmap), so it is meant for hosts and is not included
+ * by dsmr.h.
+ */
+
+#ifndef DSMR_INCLUDE_ARCHIVE_H
+#define DSMR_INCLUDE_ARCHIVE_H
+
+#include <fcntl.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "batch.h"
+#include "fields.h"
+#include "parser.h"
+
+namespace dsmr
+{
+
+  /**
+   * Convert a DSMR timestamp (YYMMDDhhmmssX, where X is S for summer
+   * time or W for winter time) to seconds since the UNIX epoch (UTC).
+   * The meter sends local time, which is assumed to be Central European
+   * Time (UTC+1, or UTC+2 in summer) as used in the Benelux. Returns -1
+   * when the timestamp is invalid.
+   */
+  inline int64_t timestamp_to_unix(const char *ts, size_t len)
+  {
+    if (len != 13 || (ts[12] != 'S' && ts[12] != 'W'))
+      return -1;
+
+    int v[6];
+    for (int i = 0; i < 6; ++i)
+    {
+      if (ts[2 * i] < '0' || ts[2 * i] > '9' || ts[2 * i + 1] < '0' || ts[2 * i + 1] > '9')
+        return -1;
+      v[i] = (ts[2 * i] - '0') * 10 + (ts[2 * i + 1] - '0');
+    }
+    int y = 2000 + v[0], m = v[1], d = v[2];
+    if (m < 1 || m > 12 || d < 1 || d > 31 || v[3] > 23 || v[4] > 59 || v[5] > 60)
+      return -1;
+
+    // Days since 1970-01-01 in the proleptic Gregorian calendar (see
+    // http://howardhinnant.github.io/date_algorithms.html#days_from_civil)
+    y -= m <= 2;
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+
+    int64_t local = days * 86400 + v[3] * 3600 + v[4] * 60 + v[5];
+    return local - (ts[12] == 'S' ? 7200 : 3600);
+  }
+
+  // Convert a parsed timestamp field, see above
+  inline int64_t timestamp_to_unix(const String &ts)
+  {
+    return timestamp_to_unix(ts.c_str(), ts.length());
+  }
+
+  template <size_t N>
+  inline int64_t timestamp_to_unix(const FixedString<N> &ts)
+  {
+    return timestamp_to_unix(ts.c_str(), ts.length());
+  }
+
+  inline int64_t timestamp_to_unix(const StringView &ts)
+  {
+    return timestamp_to_unix(ts.data(), ts.length());
+  }
+
+  /**
+   * A raw P1 capture file (concatenated telegrams, see split_telegrams),
+   * mapped into memory, with an index of its telegrams by time.
+   *
+   * The index is built by parsing the timestamp (0-0:1.0.0) of every
+   * telegram using P1Parser::parse, and is stored next to the capture
+   * file, so opening it again is quick. When the capture file has grown
+   * since (e.g. because it is still being written), only the new
+   * telegrams are indexed. Telegrams that fail to parse or have no
+   * timestamp are not indexed, but are counted by skipped().
+   */
+  class TelegramArchive
+  {
+  public:
+    struct Entry
+    {
+      // Seconds since the UNIX epoch, see timestamp_to_unix
+      int64_t time;
+      // Position of the telegram in the file
+      uint64_t offset;
+      uint32_t length;
+    };
+
+    TelegramArchive() : map(NULL), map_size(0), scanned(0), skipped_count(0), error(NULL), saved(true) {}
+    ~TelegramArchive() { this->close(); }
+
+    /**
+     * Map the given capture file and load its index, or create or
+     * update it when needed. The index is stored in index_path, or in
+     * the capture file name with .idx appended when NULL. Returns false
+     * on errors, see last_error(). Failing to write the index is not an
+     * error, see index_saved().
+     */
+    bool open(const char *path, const char *index_path = NULL)
+    {
+      this->close();
+      this->error = NULL;
+      this->saved = true;
+      this->index_path = index_path ? index_path : std::string(path) + ".idx";
+
+      int fd = ::open(path, O_RDONLY);
+      if (fd < 0)
+        return this->fail("Cannot open capture file");
+      struct stat st;
+      if (fstat(fd, &st) < 0)
+      {
+        ::close(fd);
+        return this->fail("Cannot stat capture file");
+      }
+      this->map_size = st.st_size;
+      if (this->map_size)
+      {
+        void *p = mmap(NULL, this->map_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+          ::close(fd);
+          this->map_size = 0;
+          return this->fail("Cannot map capture file");
+        }
+        this->map = static_cast<const char *>(p);
+        // Telegrams are mostly read in order when indexing
+        madvise(p, this->map_size, MADV_SEQUENTIAL);
+      }
+      ::close(fd);
+
+      if (!this->load_index())
+      {
+        // No (valid) index, or it is for a different file
+        this->index.clear();
+        this->scanned = 0;
+        this->skipped_count = 0;
+      }
+      if (this->scanned < this->map_size)
+      {
+        this->scan();
+        this->saved = this->save_index();
+      }
+      if (this->map_size)
+        madvise(const_cast<char *>(this->map), this->map_size, MADV_RANDOM);
+      return true;
+    }
+
+    void close()
+    {
+      if (this->map)
+        munmap(const_cast<char *>(this->map), this->map_size);
+      this->map = NULL;
+      this->map_size = 0;
+      this->index.clear();
+      this->scanned = 0;
+      this->skipped_count = 0;
+    }
+
+    // Returns why open() failed
+    const char *last_error() const { return this->error; }
+
+    /**
+     * Returns false when open() updated the index, but could not write
+     * it to the index file (e.g. because the capture is in a read-only
+     * directory). The archive can still be used, but the index has to be
+     * built again the next time the capture is opened.
+     */
+    bool index_saved() const { return this->saved; }
+
+    // Returns all indexed telegrams, sorted by time
+    const std::vector<Entry> &entries() const { return this->index; }
+
+    // Returns the number of telegrams that were not indexed
+    size_t skipped() const { return this->skipped_count; }
+
+    /**
+     * Returns the first telegram at or after the given time, or NULL
+     * when there is none.
+     */
+    const Entry *find(int64_t time) const
+    {
+      auto it = std::lower_bound(this->index.begin(), this->index.end(), time,
+                                 [](const Entry &e, int64_t t) { return e.time < t; });
+      return it == this->index.end() ? NULL : &*it;
+    }
+
+    /**
+     * Returns the first telegram at or after the given DSMR timestamp
+     * (YYMMDDhhmmssX), or NULL when there is none or the timestamp is
+     * invalid.
+     */
+    const Entry *find(const char *timestamp) const
+    {
+      int64_t time = timestamp_to_unix(timestamp, strlen(timestamp));
+      return time < 0 ? NULL : this->find(time);
+    }
+
+    // Returns the location of the telegram in the mapped file
+    TelegramSpan telegram(const Entry &e) const
+    {
+      TelegramSpan span = {this->map + e.offset, e.length};
+      return span;
+    }
+
+    // Parse the given telegram using P1Parser::parse
+    template <typename... Ts>
+    ParseResult<void> parse(const Entry &e, ParsedData<Ts...> *data, bool unknown_error = false) const
+    {
+      return P1Parser::parse(data, this->map + e.offset, e.length, unknown_error);
+    }
+
+  protected:
+    typedef ParsedData<fields::timestamp> TimestampData;
+
+    static const char *magic() { return "DSMRIDX2"; }
+    static const size_t HEADER_LEN = 8 + 4 * 8;
+    static const size_t ENTRY_LEN = 8 + 8 + 4;
+    // Bytes at the start and end of the scanned part of the capture that
+    // are hashed, see scanned_hash()
+    static const size_t CHECK_LEN = 4096;
+
+    const char *map;
+    size_t map_size;
+    std::string index_path;
+    std::vector<Entry> index;
+    // Number of bytes of the capture file covered by the index
+    uint64_t scanned;
+    size_t skipped_count;
+    const char *error;
+    bool saved;
+
+    bool fail(const char *error)
+    {
+      this->close();
+      this->error = error;
+      return false;
+    }
+
+    // Index the telegrams after the scanned part of the file
+    void scan()
+    {
+      const char *start = this->map + this->scanned, *end = this->map + this->map_size;
+      std::vector<TelegramSpan> spans = split_telegrams(start, end - start);
+      this->scanned = this->map_size;
+      for (size_t i = 0; i < spans.size(); ++i)
+      {
+        TimestampData data;
+        ParseResult<void> res = P1Parser::parse(&data, spans[i].start, spans[i].length);
+        int64_t time = res.err || !data.present<fields::timestamp>() ? -1 : timestamp_to_unix(data.timestamp);
+
+        if (time >= 0)
+        {
+          Entry e = {time, (uint64_t)(spans[i].start - this->map), (uint32_t)spans[i].length};
+          this->index.push_back(e);
+        }
+        else if (res.err && i + 1 == spans.size() && spans[i].end() == end)
+        {
+          // The last telegram might still be being written, so index it
+          // next time
+          this->scanned = spans[i].start - this->map;
+        }
+        else
+        {
+          this->skipped_count++;
+        }
+      }
+
+      // Captures are normally in order already, but the meter clock
+      // might have been adjusted
+      std::stable_sort(this->index.begin(), this->index.end(),
+                       [](const Entry &a, const Entry &b) { return a.time < b.time; });
+    }
+
+    static void put_le(unsigned char *p, uint64_t v, size_t len)
+    {
+      for (size_t i = 0; i < len; ++i)
+        p[i] = v >> (8 * i);
+    }
+
+    static uint64_t get_le(const unsigned char *p, size_t len)
+    {
+      uint64_t v = 0;
+      for (size_t i = 0; i < len; ++i)
+        v |= (uint64_t)p[i] << (8 * i);
+      return v;
+    }
+
+    // FNV-1a hash of the first and last CHECK_LEN bytes of the first
+    // scanned bytes of the capture. Appending to the capture keeps it
+    // the same, but replacing the capture with another one changes it.
+    uint64_t scanned_hash(uint64_t scanned) const
+    {
+      uint64_t hash = 14695981039346656037ull;
+      size_t head = std::min<uint64_t>(scanned, CHECK_LEN);
+      size_t tail = std::min<uint64_t>(scanned - head, CHECK_LEN);
+      for (size_t i = 0; i < head; ++i)
+        hash = (hash ^ (unsigned char)this->map[i]) * 1099511628211ull;
+      for (size_t i = scanned - tail; i < scanned; ++i)
+        hash = (hash ^ (unsigned char)this->map[i]) * 1099511628211ull;
+      return hash;
+    }
+
+    // The index file has a header with a magic string, the number of
+    // bytes scanned, the number of skipped telegrams, the number of
+    // entries and the scanned_hash() of the capture, followed by the
+    // entries, all little-endian.
+    bool load_index()
+    {
+      FILE *f = fopen(this->index_path.c_str(), "rb");
+      if (!f)
+        return false;
+      struct stat st;
+      unsigned char header[HEADER_LEN];
+      bool ok = fstat(fileno(f), &st) == 0 && fread(header, 1, HEADER_LEN, f) == HEADER_LEN &&
+                !memcmp(header, magic(), 8);
+      if (ok)
+      {
+        this->scanned = get_le(header + 8, 8);
+        this->skipped_count = get_le(header + 16, 8);
+        uint64_t count = get_le(header + 24, 8);
+        // Check the header before trusting count: each entry is a
+        // telegram of at least one byte, and the file must be exactly
+        // large enough for the entries
+        ok = this->scanned <= this->map_size && count <= this->scanned &&
+             (uint64_t)st.st_size == HEADER_LEN + count * ENTRY_LEN &&
+             get_le(header + 32, 8) == this->scanned_hash(this->scanned);
+        if (ok)
+          this->index.resize(count);
+        unsigned char buf[ENTRY_LEN];
+        for (uint64_t i = 0; ok && i < this->index.size(); ++i)
+        {
+          ok = fread(buf, 1, ENTRY_LEN, f) == ENTRY_LEN;
+          this->index[i].time = (int64_t)get_le(buf, 8);
+          this->index[i].offset = get_le(buf + 8, 8);
+          this->index[i].length = get_le(buf + 16, 4);
+          ok = ok && this->index[i].offset + this->index[i].length <= this->map_size;
+        }
+      }
+      fclose(f);
+      return ok;
+    }
+
+    bool save_index()
+    {
+      // Write a new file and rename it, so readers never see a partial
+      // index
+      std::string tmp = this->index_path + ".tmp";
+      FILE *f = fopen(tmp.c_str(), "wb");
+      if (!f)
+        return false;
+      unsigned char header[HEADER_LEN];
+      memcpy(header, magic(), 8);
+      put_le(header + 8, this->scanned, 8);
+      put_le(header + 16, this->skipped_count, 8);
+      put_le(header + 24, this->index.size(), 8);
+      put_le(header + 32, this->scanned_hash(this->scanned), 8);
+      bool ok = fwrite(header, 1, HEADER_LEN, f) == HEADER_LEN;
+      unsigned char buf[ENTRY_LEN];
+      for (size_t i = 0; ok && i < this->index.size(); ++i)
+      {
+        put_le(buf, this->index[i].time, 8);
+        put_le(buf + 8, this->index[i].offset, 8);
+        put_le(buf + 16, this->index[i].length, 4);
+        ok = fwrite(buf, 1, ENTRY_LEN, f) == ENTRY_LEN;
+      }
+      ok = fclose(f) == 0 && ok;
+      if (ok)
+        ok = rename(tmp.c_str(), this->index_path.c_str()) == 0;
+      else
+        remove(tmp.c_str());
+      return ok;
+    }
+  };
+
+} // namespace dsmr
+
+#endif // DSMR_INCLUDE_ARCHIVE_H
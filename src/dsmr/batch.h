@@ -0,0 +1,210 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Batch parsing of archives of concatenated telegrams, using multiple
+ * threads. This needs std::thread, so it is meant for hosts (e.g.
+ * server-side processing of stored P1 data) and is not included by
+ * dsmr.h.
+ */
+
+#ifndef DSMR_INCLUDE_BATCH_H
+#define DSMR_INCLUDE_BATCH_H
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "parser.h"
+
+namespace dsmr
+{
+
+  /**
+   * The location of a single telegram in a larger buffer.
+   */
+  struct TelegramSpan
+  {
+    const char *start;
+    size_t length;
+
+    const char *end() const { return this->start + this->length; }
+  };
+
+  /**
+   * Split a buffer of concatenated telegrams into the individual
+   * telegrams. Each telegram starts with a / and runs up to where the
+   * .next pointer of P1Parser::parse points when the checksum is
+   * correct: including the four checksum characters after the !, even
+   * when its data contains a / (e.g. in a text message). Anything
+   * between telegrams (usually CRLF) is skipped.
+   *
+   * Only telegrams with a / in their data are actually parsed (without
+   * storing any fields) for this, for the others the end is found by
+   * looking for the !.
+   *
+   * When a telegram with a / in its data has no correct checksum (e.g.
+   * because it is cut off at the start of a capture, and the next
+   * telegram starts there), it ends at that /, so it fails to parse on
+   * its own without affecting the next one.
+   */
+  inline std::vector<TelegramSpan> split_telegrams(const char *str, size_t n)
+  {
+    std::vector<TelegramSpan> spans;
+    const char *end = str + n;
+    const char *p = (const char *)memchr(str, '/', n);
+    while (p)
+    {
+      const char *bang = (const char *)memchr(p + 1, '!', end - (p + 1));
+      const char *next = (const char *)memchr(p + 1, '/', (bang ? bang : end) - (p + 1));
+      const char *telegram_end;
+      if (next)
+      {
+        // A / in the data: either the telegram is cut off and the next
+        // one starts here, or the / is part of a value. Only parsing
+        // tells. P1Parser::parse only sets .next on errors after the
+        // checksum was verified, so then the extent of the telegram is
+        // known too.
+        ParsedData<> none;
+        ParseResult<void> res = P1Parser::parse(&none, p, end - p);
+        if (res.next)
+        {
+          telegram_end = res.next;
+          next = NULL;
+        }
+        else
+        {
+          telegram_end = next;
+        }
+      }
+      else if (bang)
+      {
+        // This is where .next would point when the telegram is valid
+        telegram_end = std::min(bang + 1 + CrcParser::CRC_LEN, end);
+      }
+      else
+      {
+        telegram_end = end;
+      }
+
+      TelegramSpan span = {p, (size_t)(telegram_end - p)};
+      spans.push_back(span);
+
+      p = next ? next : (const char *)memchr(telegram_end, '/', end - telegram_end);
+    }
+    return spans;
+  }
+
+  /**
+   * The result of parsing a single telegram in a batch.
+   */
+  template <typename Data>
+  struct BatchResult
+  {
+    Data data;
+    TelegramSpan telegram;
+    ParseResult<void> result;
+
+    bool ok() const { return !this->result.err; }
+
+    // Returns the error with context, see ParseResult::fullError
+    String fullError() const
+    {
+      return this->result.fullError(this->telegram.start, this->telegram.end());
+    }
+  };
+
+  // Joins the threads it holds when it goes out of scope, also when an
+  // exception is thrown (e.g. because a thread could not be started)
+  struct _ThreadJoiner
+  {
+    std::vector<std::thread> threads;
+
+    ~_ThreadJoiner()
+    {
+      for (std::thread &t : this->threads)
+        if (t.joinable())
+          t.join();
+    }
+  };
+
+  /**
+   * Parse all telegrams in a buffer of concatenated telegrams (see
+   * split_telegrams), spreading the work over the given number of
+   * threads (or one per core when 0). Returns one result per telegram,
+   * in the order of the telegrams in the buffer, each with either the
+   * parsed data or the error for that telegram.
+   *
+   * This keeps the parsed data of all telegrams in memory, so to process
+   * very large archives, call this on parts of the archive at a time
+   * (e.g. a day of data).
+   */
+  template <typename Data>
+  std::vector<BatchResult<Data>> parse_batch(const char *str, size_t n, unsigned threads = 0,
+                                             bool unknown_error = false)
+  {
+    std::vector<TelegramSpan> spans = split_telegrams(str, n);
+    std::vector<BatchResult<Data>> results(spans.size());
+
+    // Threads take this many telegrams at a time, to keep contention on
+    // the shared counter low
+    const size_t BLOCK = 16;
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+      size_t first;
+      while ((first = next.fetch_add(BLOCK)) < spans.size())
+      {
+        size_t last = std::min(first + BLOCK, spans.size());
+        for (size_t i = first; i < last; ++i)
+        {
+          BatchResult<Data> &r = results[i];
+          r.telegram = spans[i];
+          r.result = P1Parser::parse(&r.data, spans[i].start, spans[i].length, unknown_error);
+        }
+      }
+    };
+
+    if (!threads)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads, (spans.size() + BLOCK - 1) / BLOCK);
+
+    // The calling thread does its share of the work too
+    {
+      _ThreadJoiner workers;
+      for (unsigned i = 1; i < threads; ++i)
+        workers.threads.emplace_back(work);
+      work();
+    }
+
+    return results;
+  }
+
+} // namespace dsmr
+
+#endif // DSMR_INCLUDE_BATCH_H
@@ -0,0 +1,307 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Columnar storage of a series of parsed telegrams, for analysis of
+ * many telegrams. This uses std::vector, so it is meant for hosts and
+ * is not included by dsmr.h.
+ */
+
+#ifndef DSMR_INCLUDE_COLUMNS_H
+#define DSMR_INCLUDE_COLUMNS_H
+
+#include <stdint.h>
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fields.h"
+
+namespace dsmr
+{
+
+  /**
+   * The type stored in a column for fields with values of type V:
+   * integers are stored as they are, FixedValues as their integer value
+   * (i.e. in thousands, see FixedValue). Other values (strings) are not
+   * stored, only whether they are present.
+   */
+  template <typename V>
+  struct _ColumnValue
+  {
+    typedef void type;
+  };
+
+  template <>
+  struct _ColumnValue<uint8_t>
+  {
+    typedef uint8_t type;
+  };
+
+  template <>
+  struct _ColumnValue<uint16_t>
+  {
+    typedef uint16_t type;
+  };
+
+  template <>
+  struct _ColumnValue<uint32_t>
+  {
+    typedef uint32_t type;
+  };
+
+  template <>
+  struct _ColumnValue<FixedValue>
+  {
+    typedef uint32_t type;
+  };
+
+  template <>
+  struct _ColumnValue<TimestampedFixedValue>
+  {
+    typedef uint32_t type;
+  };
+
+  inline uint32_t _column_value(const FixedValue &v) { return v._value; }
+  inline uint32_t _column_value(uint32_t v) { return v; }
+
+  /**
+   * Presence bits of a column, one bit per row.
+   */
+  struct _PresenceColumn
+  {
+    std::vector<uint64_t> present;
+
+    bool is_present(size_t row) const { return this->present[row / 64] >> (row % 64) & 1; }
+  };
+
+  template <typename V, typename = typename _ColumnValue<V>::type>
+  struct _Column : _PresenceColumn
+  {
+    typedef typename _ColumnValue<V>::type value_type;
+
+    // Value of each row, 0 when not present
+    std::vector<value_type> values;
+
+    void append(size_t row, bool present, const V &v)
+    {
+      this->values.push_back(present ? _column_value(v) : 0);
+      if (present)
+        this->present[row / 64] |= (uint64_t)1 << (row % 64);
+    }
+
+    void reserve(size_t rows) { this->values.reserve(rows); }
+    void clear() { this->values.clear(); }
+  };
+
+  template <typename V>
+  struct _Column<V, void> : _PresenceColumn
+  {
+    void append(size_t row, bool present, const V & /* v */)
+    {
+      if (present)
+        this->present[row / 64] |= (uint64_t)1 << (row % 64);
+    }
+
+    void reserve(size_t /* rows */) {}
+    void clear() {}
+  };
+
+  /**
+   * Aggregate of the present values in a column, as returned by
+   * TelegramColumns::stats().
+   */
+  template <typename T>
+  struct ColumnStats
+  {
+    size_t count;
+    T min;
+    T max;
+    uint64_t sum;
+
+    double avg() const { return this->count ? (double)this->sum / this->count : 0; }
+  };
+
+  template <typename Data>
+  class TelegramColumns;
+
+  /**
+   * Stores a series of ParsedData in columns: for each field, the values
+   * of all rows (one row per ParsedData) are stored in a contiguous
+   * array, along with a bitmap of the rows where the field is present.
+   * Only fields with integer or FixedValue values have a value column,
+   * for other fields only presence is stored.
+   *
+   *   TelegramColumns<MyData> columns;
+   *   columns.append(data);
+   *   ...
+   *   ColumnStats<uint32_t> v = columns.stats<voltage_l1>();
+   *   float avg_voltage = v.avg() / 1000;
+   *
+   * Columns are selected by field type and looked up at compile time.
+   */
+  template <typename... Ts>
+  class TelegramColumns<ParsedData<Ts...>>
+  {
+  public:
+    typedef ParsedData<Ts...> Data;
+
+    template <typename F>
+    struct Column
+    {
+      typedef _Column<typename std::remove_reference<decltype(std::declval<F &>().val())>::type> type;
+    };
+
+    TelegramColumns() : rows(0) {}
+
+    /**
+     * Append the fields of data as a new row.
+     */
+    void append(Data &data)
+    {
+      if (this->rows % 64 == 0)
+      {
+        int expand[] = {0, (column<Ts>().present.push_back(0), 0)...};
+        (void)expand;
+      }
+      Appender appender = {this, this->rows};
+      data.applyEach(appender);
+      this->rows++;
+    }
+
+    /**
+     * Reserve room for the given number of rows in all columns.
+     */
+    void reserve(size_t rows)
+    {
+      int expand[] = {0, (column<Ts>().reserve(rows), column<Ts>().present.reserve((rows + 63) / 64), 0)...};
+      (void)expand;
+    }
+
+    void clear()
+    {
+      int expand[] = {0, (column<Ts>().clear(), column<Ts>().present.clear(), 0)...};
+      (void)expand;
+      this->rows = 0;
+    }
+
+    size_t size() const { return this->rows; }
+
+    /**
+     * Returns the column for field F, which has a present bitmap and
+     * (for integer and FixedValue fields) values.
+     */
+    template <typename F>
+    const typename Column<F>::type &column() const
+    {
+      return std::get<_FieldIndex<F, Ts...>::value>(this->columns);
+    }
+
+    /**
+     * Returns whether field F was present in the given row.
+     */
+    template <typename F>
+    bool present(size_t row) const { return column<F>().is_present(row); }
+
+    /**
+     * Returns the value of field F in the given row, or 0 when it was not
+     * present.
+     */
+    template <typename F>
+    typename Column<F>::type::value_type value(size_t row) const { return column<F>().values[row]; }
+
+    /**
+     * Returns the number of rows, minimum, maximum and sum of the rows
+     * where field F is present. min and max are 0 when no row has F.
+     */
+    template <typename F>
+    ColumnStats<typename Column<F>::type::value_type> stats() const
+    {
+      typedef typename Column<F>::type::value_type T;
+      const typename Column<F>::type &col = column<F>();
+      ColumnStats<T> res = {0, (T)~(T)0, 0, 0};
+      const T *values = col.values.data();
+      for (size_t word = 0; word * 64 < this->rows; ++word)
+      {
+        uint64_t bits = col.present[word];
+        size_t n = this->rows - word * 64 < 64 ? this->rows - word * 64 : 64;
+        const T *v = values + word * 64;
+        if (n == 64 && bits == ~(uint64_t)0)
+        {
+          // All present, a simple loop that the compiler can vectorize
+          T min = res.min, max = res.max;
+          uint64_t sum = 0;
+          for (size_t i = 0; i < 64; ++i)
+          {
+            min = v[i] < min ? v[i] : min;
+            max = v[i] > max ? v[i] : max;
+            sum += v[i];
+          }
+          res.min = min;
+          res.max = max;
+          res.sum += sum;
+          res.count += 64;
+          continue;
+        }
+        for (; bits; bits &= bits - 1)
+        {
+          T x = v[__builtin_ctzll(bits)];
+          res.min = x < res.min ? x : res.min;
+          res.max = x > res.max ? x : res.max;
+          res.sum += x;
+          res.count++;
+        }
+      }
+      if (!res.count)
+        res.min = 0;
+      return res;
+    }
+
+  protected:
+    template <typename F>
+    typename Column<F>::type &column() { return std::get<_FieldIndex<F, Ts...>::value>(this->columns); }
+
+    struct Appender
+    {
+      TelegramColumns *self;
+      size_t row;
+
+      template <typename Item>
+      void apply(Item &i, bool present)
+      {
+        this->self->template column<Item>().append(this->row, present, i.val());
+      }
+    };
+
+    std::tuple<typename Column<Ts>::type...> columns;
+    size_t rows;
+  };
+
+} // namespace dsmr
+
+#endif // DSMR_INCLUDE_COLUMNS_H
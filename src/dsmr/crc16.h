@@ -105,3 +105,234 @@ static inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data)
   }
   return crc;
 }
+
+/* Block CRC16 (polynomial 0xA001, reflected 0x8005, as used by DSMR).
+
+   crc16_update(crc, buf, len) is equivalent to calling
+   _crc16_update(crc, c) for every byte in buf, but picks a faster
+   implementation at compiletime:
+
+    - DSMR_CRC16_CLMUL: Carry-less multiplication folding, for x86-64
+      targets compiled with PCLMUL support (e.g. -mpclmul or
+      -march=native). Falls back to slice-by-8 for short blocks.
+    - DSMR_CRC16_SLICE8: Slice-by-8, processing 8 bytes per step using
+      8 lookup tables (4 kiB). Default for 32/64-bit non-Arduino hosts.
+    - DSMR_CRC16_TABLE: Byte-wise lookup in a single 256-entry table
+      (512 bytes, stored in PROGMEM on AVR). Default on Arduino.
+    - DSMR_CRC16_BITWISE: The bitwise _crc16_update above, the
+      reference that all other variants must match.
+
+   Define DSMR_CRC16_IMPL to one of these before including this file to
+   override the automatic choice. */
+
+#include <stddef.h>
+
+#define DSMR_CRC16_BITWISE 0
+#define DSMR_CRC16_TABLE 1
+#define DSMR_CRC16_SLICE8 2
+#define DSMR_CRC16_CLMUL 3
+
+#ifndef DSMR_CRC16_IMPL
+#if defined(__x86_64__) && defined(__PCLMUL__) && defined(__SSE2__)
+#define DSMR_CRC16_IMPL DSMR_CRC16_CLMUL
+#elif !defined(ARDUINO) && __SIZEOF_POINTER__ >= 4
+#define DSMR_CRC16_IMPL DSMR_CRC16_SLICE8
+#else
+#define DSMR_CRC16_IMPL DSMR_CRC16_TABLE
+#endif
+#endif
+
+#if DSMR_CRC16_IMPL == DSMR_CRC16_CLMUL
+#include <string.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define _CRC16_TABLE_PROGMEM PROGMEM
+#define _CRC16_TABLE_READ(p) pgm_read_word(p)
+#else
+#define _CRC16_TABLE_PROGMEM
+#define _CRC16_TABLE_READ(p) (*(p))
+#endif
+
+/* Bitwise reference implementation */
+static inline uint16_t _crc16_update_bitwise(uint16_t crc, const char *buf, size_t len) __attribute__((unused));
+static inline uint16_t _crc16_update_bitwise(uint16_t crc, const char *buf, size_t len)
+{
+  while (len--)
+    crc = _crc16_update(crc, *buf++);
+  return crc;
+}
+
+/* Returns _crc16_update(0, i) for every i */
+inline uint16_t _crc16_table_lookup(uint8_t i)
+{
+  static const uint16_t table[256] _CRC16_TABLE_PROGMEM = {
+      0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+      0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+      0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+      0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+      0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+      0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+      0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+      0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+      0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+      0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+      0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+      0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+      0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+      0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+      0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+      0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+      0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+      0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+      0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+      0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+      0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+      0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+      0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+      0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+      0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+      0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+      0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+      0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+      0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+      0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+      0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+      0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+  };
+  return _CRC16_TABLE_READ(&table[i]);
+}
+
+/* Byte-wise table-driven implementation */
+static inline uint16_t _crc16_update_table(uint16_t crc, const char *buf, size_t len) __attribute__((unused));
+static inline uint16_t _crc16_update_table(uint16_t crc, const char *buf, size_t len)
+{
+  while (len--)
+    crc = (crc >> 8) ^ _crc16_table_lookup((crc ^ (uint8_t)*buf++) & 0xff);
+  return crc;
+}
+
+#if DSMR_CRC16_IMPL >= DSMR_CRC16_SLICE8
+/* Slice-by-8 tables: t[k][i] is the CRC of byte i followed by k zero
+   bytes, so 8 input bytes can be folded in with 8 independent lookups.
+   Built once, on first use. */
+struct _crc16_slice8_tables
+{
+  uint16_t t[8][256];
+
+  _crc16_slice8_tables()
+  {
+    for (unsigned i = 0; i < 256; ++i)
+      t[0][i] = _crc16_table_lookup(i);
+    for (unsigned k = 1; k < 8; ++k)
+      for (unsigned i = 0; i < 256; ++i)
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+  }
+
+  static const _crc16_slice8_tables &get()
+  {
+    static const _crc16_slice8_tables tables;
+    return tables;
+  }
+};
+
+static inline uint16_t _crc16_update_slice8(uint16_t crc, const char *buf, size_t len) __attribute__((unused));
+static inline uint16_t _crc16_update_slice8(uint16_t crc, const char *buf, size_t len)
+{
+  const uint8_t *p = (const uint8_t *)buf;
+  if (len >= 8)
+  {
+    const uint16_t(*t)[256] = _crc16_slice8_tables::get().t;
+    while (len >= 8)
+    {
+      crc = t[7][(p[0] ^ crc) & 0xff] ^ t[6][p[1] ^ (crc >> 8)] ^
+            t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+      p += 8;
+      len -= 8;
+    }
+  }
+  return _crc16_update_table(crc, (const char *)p, len);
+}
+#endif // DSMR_CRC16_IMPL >= DSMR_CRC16_SLICE8
+
+#if DSMR_CRC16_IMPL == DSMR_CRC16_CLMUL
+/* Carry-less multiplication folding. Since the CRC is linear and the
+   initial crc value can be xored into the first two message bytes, the
+   message can be folded 64 (then 16) bytes at a time into a single
+   128-bit remainder that has the same CRC as the folded part. That
+   remainder and any tail bytes are then finished with slice-by-8.
+
+   With the reflected bit order, the low qword of a register holds the
+   high-order half of the polynomial. The folding constants are
+   bit-reversed (x^(n-1) mod P), the -1 compensating for the implicit
+   multiplication by x of a reflected carry-less multiply. */
+static inline __m128i _crc16_clmul_fold(__m128i acc, __m128i k) __attribute__((always_inline, unused));
+static inline __m128i _crc16_clmul_fold(__m128i acc, __m128i k)
+{
+  return _mm_xor_si128(_mm_clmulepi64_si128(acc, k, 0x00), _mm_clmulepi64_si128(acc, k, 0x11));
+}
+
+static inline uint16_t _crc16_update_clmul(uint16_t crc, const char *buf, size_t len) __attribute__((unused));
+static inline uint16_t _crc16_update_clmul(uint16_t crc, const char *buf, size_t len)
+{
+  if (len < 64)
+    return _crc16_update_slice8(crc, buf, len);
+
+  // x^575 mod P, x^511 mod P: fold across 64 bytes
+  const __m128i k64 = _mm_set_epi64x((long long)0x8101000000000000ULL, (long long)0xc450000000000000ULL);
+  // x^191 mod P, x^127 mod P: fold across 16 bytes
+  const __m128i k16 = _mm_set_epi64x((long long)0xc100000000000000ULL, (long long)0xccd0000000000000ULL);
+
+  const __m128i *p = (const __m128i *)buf;
+  __m128i a0 = _mm_xor_si128(_mm_loadu_si128(p + 0), _mm_cvtsi32_si128(crc));
+  __m128i a1 = _mm_loadu_si128(p + 1);
+  __m128i a2 = _mm_loadu_si128(p + 2);
+  __m128i a3 = _mm_loadu_si128(p + 3);
+  p += 4;
+  len -= 64;
+
+  while (len >= 64)
+  {
+    a0 = _mm_xor_si128(_crc16_clmul_fold(a0, k64), _mm_loadu_si128(p + 0));
+    a1 = _mm_xor_si128(_crc16_clmul_fold(a1, k64), _mm_loadu_si128(p + 1));
+    a2 = _mm_xor_si128(_crc16_clmul_fold(a2, k64), _mm_loadu_si128(p + 2));
+    a3 = _mm_xor_si128(_crc16_clmul_fold(a3, k64), _mm_loadu_si128(p + 3));
+    p += 4;
+    len -= 64;
+  }
+
+  __m128i acc = _mm_xor_si128(_crc16_clmul_fold(a0, k16), a1);
+  acc = _mm_xor_si128(_crc16_clmul_fold(acc, k16), a2);
+  acc = _mm_xor_si128(_crc16_clmul_fold(acc, k16), a3);
+  while (len >= 16)
+  {
+    acc = _mm_xor_si128(_crc16_clmul_fold(acc, k16), _mm_loadu_si128(p));
+    ++p;
+    len -= 16;
+  }
+
+  char rem[16];
+  _mm_storeu_si128((__m128i *)rem, acc);
+  crc = _crc16_update_slice8(0, rem, sizeof(rem));
+  return _crc16_update_slice8(crc, (const char *)p, len);
+}
+#endif // DSMR_CRC16_IMPL == DSMR_CRC16_CLMUL
+
+/* Update crc with len bytes from buf, using the implementation selected
+   by DSMR_CRC16_IMPL. */
+static inline uint16_t crc16_update(uint16_t crc, const char *buf, size_t len) __attribute__((unused));
+static inline uint16_t crc16_update(uint16_t crc, const char *buf, size_t len)
+{
+#if DSMR_CRC16_IMPL == DSMR_CRC16_CLMUL
+  return _crc16_update_clmul(crc, buf, len);
+#elif DSMR_CRC16_IMPL == DSMR_CRC16_SLICE8
+  return _crc16_update_slice8(crc, buf, len);
+#elif DSMR_CRC16_IMPL == DSMR_CRC16_TABLE
+  return _crc16_update_table(crc, buf, len);
+#else
+  return _crc16_update_bitwise(crc, buf, len);
+#endif
+}
@@ -36,7 +36,8 @@ using namespace dsmr::fields;
 // Since C++11 it is possible to define the initial values for static
 // const members in the class declaration, but if their address is
 // taken, they still need a normal definition somewhere (to allocate
-// storage).
+// storage). The name pointers are initialized here, since a
+// reinterpret_cast is not allowed in a constant expression.
 constexpr char units::none[];
 constexpr char units::kWh[];
 constexpr char units::Wh[];
@@ -55,279 +56,284 @@ constexpr char units::kvarh[];
 
 constexpr ObisId identification::id;
 constexpr char identification::name_progmem[];
-constexpr const __FlashStringHelper *identification::name;
+const __FlashStringHelper *const identification::name = reinterpret_cast<const __FlashStringHelper *>(&identification::name_progmem);
 
 constexpr ObisId p1_version::id;
 constexpr char p1_version::name_progmem[];
-constexpr const __FlashStringHelper *p1_version::name;
+const __FlashStringHelper *const p1_version::name = reinterpret_cast<const __FlashStringHelper *>(&p1_version::name_progmem);
 
 /* extra field for Belgium */
 constexpr ObisId p1_version_be::id;
 constexpr char p1_version_be::name_progmem[];
-constexpr const __FlashStringHelper *p1_version_be::name;
+const __FlashStringHelper *const p1_version_be::name = reinterpret_cast<const __FlashStringHelper *>(&p1_version_be::name_progmem);
 
 constexpr ObisId timestamp::id;
 constexpr char timestamp::name_progmem[];
-constexpr const __FlashStringHelper *timestamp::name;
+const __FlashStringHelper *const timestamp::name = reinterpret_cast<const __FlashStringHelper *>(&timestamp::name_progmem);
 
 constexpr ObisId equipment_id::id;
 constexpr char equipment_id::name_progmem[];
-constexpr const __FlashStringHelper *equipment_id::name;
+const __FlashStringHelper *const equipment_id::name = reinterpret_cast<const __FlashStringHelper *>(&equipment_id::name_progmem);
 
 /* extra for Lux */
 constexpr ObisId energy_delivered_lux::id;
 constexpr char energy_delivered_lux::name_progmem[];
-constexpr const __FlashStringHelper *energy_delivered_lux::name;
+const __FlashStringHelper *const energy_delivered_lux::name = reinterpret_cast<const __FlashStringHelper *>(&energy_delivered_lux::name_progmem);
 
 constexpr ObisId energy_delivered_tariff1::id;
 constexpr char energy_delivered_tariff1::name_progmem[];
-constexpr const __FlashStringHelper *energy_delivered_tariff1::name;
+const __FlashStringHelper *const energy_delivered_tariff1::name = reinterpret_cast<const __FlashStringHelper *>(&energy_delivered_tariff1::name_progmem);
 
 constexpr ObisId energy_delivered_tariff2::id;
 constexpr char energy_delivered_tariff2::name_progmem[];
-constexpr const __FlashStringHelper *energy_delivered_tariff2::name;
+const __FlashStringHelper *const energy_delivered_tariff2::name = reinterpret_cast<const __FlashStringHelper *>(&energy_delivered_tariff2::name_progmem);
 
 /* extra for Lux */
 constexpr ObisId energy_returned_lux::id;
 constexpr char energy_returned_lux::name_progmem[];
-constexpr const __FlashStringHelper *energy_returned_lux::name;
+const __FlashStringHelper *const energy_returned_lux::name = reinterpret_cast<const __FlashStringHelper *>(&energy_returned_lux::name_progmem);
 
 constexpr ObisId energy_returned_tariff1::id;
 constexpr char energy_returned_tariff1::name_progmem[];
-constexpr const __FlashStringHelper *energy_returned_tariff1::name;
+const __FlashStringHelper *const energy_returned_tariff1::name = reinterpret_cast<const __FlashStringHelper *>(&energy_returned_tariff1::name_progmem);
 
 constexpr ObisId energy_returned_tariff2::id;
 constexpr char energy_returned_tariff2::name_progmem[];
-constexpr const __FlashStringHelper *energy_returned_tariff2::name;
+const __FlashStringHelper *const energy_returned_tariff2::name = reinterpret_cast<const __FlashStringHelper *>(&energy_returned_tariff2::name_progmem);
 
 /* extra for Lux */
 constexpr ObisId total_imported_energy::id;
 constexpr char total_imported_energy::name_progmem[];
-constexpr const __FlashStringHelper *total_imported_energy::name;
+const __FlashStringHelper *const total_imported_energy::name = reinterpret_cast<const __FlashStringHelper *>(&total_imported_energy::name_progmem);
 
 /* extra for Lux */
 constexpr ObisId total_exported_energy::id;
 constexpr char total_exported_energy::name_progmem[];
-constexpr const __FlashStringHelper *total_exported_energy::name;
+const __FlashStringHelper *const total_exported_energy::name = reinterpret_cast<const __FlashStringHelper *>(&total_exported_energy::name_progmem);
 
 /* extra for Lux */
 constexpr ObisId reactive_power_delivered::id;
 constexpr char reactive_power_delivered::name_progmem[];
-constexpr const __FlashStringHelper *reactive_power_delivered::name;
+const __FlashStringHelper *const reactive_power_delivered::name = reinterpret_cast<const __FlashStringHelper *>(&reactive_power_delivered::name_progmem);
 
 /* extra for Lux */
 constexpr ObisId reactive_power_returned::id;
 constexpr char reactive_power_returned::name_progmem[];
-constexpr const __FlashStringHelper *reactive_power_returned::name;
+const __FlashStringHelper *const reactive_power_returned::name = reinterpret_cast<const __FlashStringHelper *>(&reactive_power_returned::name_progmem);
 
 constexpr ObisId electricity_tariff::id;
 constexpr char electricity_tariff::name_progmem[];
-constexpr const __FlashStringHelper *electricity_tariff::name;
+const __FlashStringHelper *const electricity_tariff::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_tariff::name_progmem);
 
 constexpr ObisId power_delivered::id;
 constexpr char power_delivered::name_progmem[];
-constexpr const __FlashStringHelper *power_delivered::name;
+const __FlashStringHelper *const power_delivered::name = reinterpret_cast<const __FlashStringHelper *>(&power_delivered::name_progmem);
 
 constexpr ObisId power_returned::id;
 constexpr char power_returned::name_progmem[];
-constexpr const __FlashStringHelper *power_returned::name;
+const __FlashStringHelper *const power_returned::name = reinterpret_cast<const __FlashStringHelper *>(&power_returned::name_progmem);
 
 constexpr ObisId electricity_threshold::id;
 constexpr char electricity_threshold::name_progmem[];
-constexpr const __FlashStringHelper *electricity_threshold::name;
+const __FlashStringHelper *const electricity_threshold::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_threshold::name_progmem);
 
 constexpr ObisId electricity_switch_position::id;
 constexpr char electricity_switch_position::name_progmem[];
-constexpr const __FlashStringHelper *electricity_switch_position::name;
+const __FlashStringHelper *const electricity_switch_position::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_switch_position::name_progmem);
 
 constexpr ObisId electricity_failures::id;
 constexpr char electricity_failures::name_progmem[];
-constexpr const __FlashStringHelper *electricity_failures::name;
+const __FlashStringHelper *const electricity_failures::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_failures::name_progmem);
 
 constexpr ObisId electricity_long_failures::id;
 constexpr char electricity_long_failures::name_progmem[];
-constexpr const __FlashStringHelper *electricity_long_failures::name;
+const __FlashStringHelper *const electricity_long_failures::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_long_failures::name_progmem);
 
 constexpr ObisId electricity_failure_log::id;
 constexpr char electricity_failure_log::name_progmem[];
-constexpr const __FlashStringHelper *electricity_failure_log::name;
+const __FlashStringHelper *const electricity_failure_log::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_failure_log::name_progmem);
 
 constexpr ObisId electricity_sags_l1::id;
 constexpr char electricity_sags_l1::name_progmem[];
-constexpr const __FlashStringHelper *electricity_sags_l1::name;
+const __FlashStringHelper *const electricity_sags_l1::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_sags_l1::name_progmem);
 
 constexpr ObisId electricity_sags_l2::id;
 constexpr char electricity_sags_l2::name_progmem[];
-constexpr const __FlashStringHelper *electricity_sags_l2::name;
+const __FlashStringHelper *const electricity_sags_l2::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_sags_l2::name_progmem);
 
 constexpr ObisId electricity_sags_l3::id;
 constexpr char electricity_sags_l3::name_progmem[];
-constexpr const __FlashStringHelper *electricity_sags_l3::name;
+const __FlashStringHelper *const electricity_sags_l3::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_sags_l3::name_progmem);
 
 constexpr ObisId electricity_swells_l1::id;
 constexpr char electricity_swells_l1::name_progmem[];
-constexpr const __FlashStringHelper *electricity_swells_l1::name;
+const __FlashStringHelper *const electricity_swells_l1::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_swells_l1::name_progmem);
 
 constexpr ObisId electricity_swells_l2::id;
 constexpr char electricity_swells_l2::name_progmem[];
-constexpr const __FlashStringHelper *electricity_swells_l2::name;
+const __FlashStringHelper *const electricity_swells_l2::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_swells_l2::name_progmem);
 
 constexpr ObisId electricity_swells_l3::id;
 constexpr char electricity_swells_l3::name_progmem[];
-constexpr const __FlashStringHelper *electricity_swells_l3::name;
+const __FlashStringHelper *const electricity_swells_l3::name = reinterpret_cast<const __FlashStringHelper *>(&electricity_swells_l3::name_progmem);
 
 constexpr ObisId message_short::id;
 constexpr char message_short::name_progmem[];
-constexpr const __FlashStringHelper *message_short::name;
+const __FlashStringHelper *const message_short::name = reinterpret_cast<const __FlashStringHelper *>(&message_short::name_progmem);
 
 constexpr ObisId message_long::id;
 constexpr char message_long::name_progmem[];
-constexpr const __FlashStringHelper *message_long::name;
+const __FlashStringHelper *const message_long::name = reinterpret_cast<const __FlashStringHelper *>(&message_long::name_progmem);
 
 constexpr ObisId voltage_l1::id;
 constexpr char voltage_l1::name_progmem[];
-constexpr const __FlashStringHelper *voltage_l1::name;
+const __FlashStringHelper *const voltage_l1::name = reinterpret_cast<const __FlashStringHelper *>(&voltage_l1::name_progmem);
 
 constexpr ObisId voltage_l2::id;
 constexpr char voltage_l2::name_progmem[];
-constexpr const __FlashStringHelper *voltage_l2::name;
+const __FlashStringHelper *const voltage_l2::name = reinterpret_cast<const __FlashStringHelper *>(&voltage_l2::name_progmem);
 
 constexpr ObisId voltage_l3::id;
 constexpr char voltage_l3::name_progmem[];
-constexpr const __FlashStringHelper *voltage_l3::name;
+const __FlashStringHelper *const voltage_l3::name = reinterpret_cast<const __FlashStringHelper *>(&voltage_l3::name_progmem);
 
 constexpr ObisId current_l1::id;
 constexpr char current_l1::name_progmem[];
-constexpr const __FlashStringHelper *current_l1::name;
+const __FlashStringHelper *const current_l1::name = reinterpret_cast<const __FlashStringHelper *>(&current_l1::name_progmem);
 
 constexpr ObisId current_l2::id;
 constexpr char current_l2::name_progmem[];
-constexpr const __FlashStringHelper *current_l2::name;
+const __FlashStringHelper *const current_l2::name = reinterpret_cast<const __FlashStringHelper *>(&current_l2::name_progmem);
 
 constexpr ObisId current_l3::id;
 constexpr char current_l3::name_progmem[];
-constexpr const __FlashStringHelper *current_l3::name;
+const __FlashStringHelper *const current_l3::name = reinterpret_cast<const __FlashStringHelper *>(&current_l3::name_progmem);
 
 constexpr ObisId power_delivered_l1::id;
 constexpr char power_delivered_l1::name_progmem[];
-constexpr const __FlashStringHelper *power_delivered_l1::name;
+const __FlashStringHelper *const power_delivered_l1::name = reinterpret_cast<const __FlashStringHelper *>(&power_delivered_l1::name_progmem);
 
 constexpr ObisId power_delivered_l2::id;
 constexpr char power_delivered_l2::name_progmem[];
-constexpr const __FlashStringHelper *power_delivered_l2::name;
+const __FlashStringHelper *const power_delivered_l2::name = reinterpret_cast<const __FlashStringHelper *>(&power_delivered_l2::name_progmem);
 
 constexpr ObisId power_delivered_l3::id;
 constexpr char power_delivered_l3::name_progmem[];
-constexpr const __FlashStringHelper *power_delivered_l3::name;
+const __FlashStringHelper *const power_delivered_l3::name = reinterpret_cast<const __FlashStringHelper *>(&power_delivered_l3::name_progmem);
 
 constexpr ObisId power_returned_l1::id;
 constexpr char power_returned_l1::name_progmem[];
-constexpr const __FlashStringHelper *power_returned_l1::name;
+const __FlashStringHelper *const power_returned_l1::name = reinterpret_cast<const __FlashStringHelper *>(&power_returned_l1::name_progmem);
 
 constexpr ObisId power_returned_l2::id;
 constexpr char power_returned_l2::name_progmem[];
-constexpr const __FlashStringHelper *power_returned_l2::name;
+const __FlashStringHelper *const power_returned_l2::name = reinterpret_cast<const __FlashStringHelper *>(&power_returned_l2::name_progmem);
 
 constexpr ObisId power_returned_l3::id;
 constexpr char power_returned_l3::name_progmem[];
-constexpr const __FlashStringHelper *power_returned_l3::name;
+const __FlashStringHelper *const power_returned_l3::name = reinterpret_cast<const __FlashStringHelper *>(&power_returned_l3::name_progmem);
 
 /* LUX */
 constexpr ObisId reactive_power_delivered_l1::id;
 constexpr char reactive_power_delivered_l1::name_progmem[];
-constexpr const __FlashStringHelper *reactive_power_delivered_l1::name;
+const __FlashStringHelper *const reactive_power_delivered_l1::name = reinterpret_cast<const __FlashStringHelper *>(&reactive_power_delivered_l1::name_progmem);
 
 /* LUX */
 constexpr ObisId reactive_power_delivered_l2::id;
 constexpr char reactive_power_delivered_l2::name_progmem[];
-constexpr const __FlashStringHelper *reactive_power_delivered_l2::name;
+const __FlashStringHelper *const reactive_power_delivered_l2::name = reinterpret_cast<const __FlashStringHelper *>(&reactive_power_delivered_l2::name_progmem);
 
 /* LUX */
 constexpr ObisId reactive_power_delivered_l3::id;
 constexpr char reactive_power_delivered_l3::name_progmem[];
-constexpr const __FlashStringHelper *reactive_power_delivered_l3::name;
+const __FlashStringHelper *const reactive_power_delivered_l3::name = reinterpret_cast<const __FlashStringHelper *>(&reactive_power_delivered_l3::name_progmem);
 
 /* LUX */
 constexpr ObisId reactive_power_returned_l1::id;
 constexpr char reactive_power_returned_l1::name_progmem[];
-constexpr const __FlashStringHelper *reactive_power_returned_l1::name;
+const __FlashStringHelper *const reactive_power_returned_l1::name = reinterpret_cast<const __FlashStringHelper *>(&reactive_power_returned_l1::name_progmem);
 
 /* LUX */
 constexpr ObisId reactive_power_returned_l2::id;
 constexpr char reactive_power_returned_l2::name_progmem[];
-constexpr const __FlashStringHelper *reactive_power_returned_l2::name;
+const __FlashStringHelper *const reactive_power_returned_l2::name = reinterpret_cast<const __FlashStringHelper *>(&reactive_power_returned_l2::name_progmem);
 
 /* LUX */
 constexpr ObisId reactive_power_returned_l3::id;
 constexpr char reactive_power_returned_l3::name_progmem[];
-constexpr const __FlashStringHelper *reactive_power_returned_l3::name;
+const __FlashStringHelper *const reactive_power_returned_l3::name = reinterpret_cast<const __FlashStringHelper *>(&reactive_power_returned_l3::name_progmem);
 
 constexpr ObisId gas_device_type::id;
 constexpr char gas_device_type::name_progmem[];
-constexpr const __FlashStringHelper *gas_device_type::name;
+const __FlashStringHelper *const gas_device_type::name = reinterpret_cast<const __FlashStringHelper *>(&gas_device_type::name_progmem);
 
 constexpr ObisId gas_equipment_id::id;
 constexpr char gas_equipment_id::name_progmem[];
-constexpr const __FlashStringHelper *gas_equipment_id::name;
+const __FlashStringHelper *const gas_equipment_id::name = reinterpret_cast<const __FlashStringHelper *>(&gas_equipment_id::name_progmem);
+
+/* extra field for Belgium */
+constexpr ObisId gas_equipment_id_be::id;
+constexpr char gas_equipment_id_be::name_progmem[];
+const __FlashStringHelper *const gas_equipment_id_be::name = reinterpret_cast<const __FlashStringHelper *>(&gas_equipment_id_be::name_progmem);
 
 constexpr ObisId gas_valve_position::id;
 constexpr char gas_valve_position::name_progmem[];
-constexpr const __FlashStringHelper *gas_valve_position::name;
+const __FlashStringHelper *const gas_valve_position::name = reinterpret_cast<const __FlashStringHelper *>(&gas_valve_position::name_progmem);
 
 /* _NL */
 constexpr ObisId gas_delivered::id;
 constexpr char gas_delivered::name_progmem[];
-constexpr const __FlashStringHelper *gas_delivered::name;
+const __FlashStringHelper *const gas_delivered::name = reinterpret_cast<const __FlashStringHelper *>(&gas_delivered::name_progmem);
 
 /* _BE */
 constexpr ObisId gas_delivered_be::id;
 constexpr char gas_delivered_be::name_progmem[];
-constexpr const __FlashStringHelper *gas_delivered_be::name;
+const __FlashStringHelper *const gas_delivered_be::name = reinterpret_cast<const __FlashStringHelper *>(&gas_delivered_be::name_progmem);
 
 constexpr ObisId thermal_device_type::id;
 constexpr char thermal_device_type::name_progmem[];
-constexpr const __FlashStringHelper *thermal_device_type::name;
+const __FlashStringHelper *const thermal_device_type::name = reinterpret_cast<const __FlashStringHelper *>(&thermal_device_type::name_progmem);
 
 constexpr ObisId thermal_equipment_id::id;
 constexpr char thermal_equipment_id::name_progmem[];
-constexpr const __FlashStringHelper *thermal_equipment_id::name;
+const __FlashStringHelper *const thermal_equipment_id::name = reinterpret_cast<const __FlashStringHelper *>(&thermal_equipment_id::name_progmem);
 
 constexpr ObisId thermal_valve_position::id;
 constexpr char thermal_valve_position::name_progmem[];
-constexpr const __FlashStringHelper *thermal_valve_position::name;
+const __FlashStringHelper *const thermal_valve_position::name = reinterpret_cast<const __FlashStringHelper *>(&thermal_valve_position::name_progmem);
 
 constexpr ObisId thermal_delivered::id;
 constexpr char thermal_delivered::name_progmem[];
-constexpr const __FlashStringHelper *thermal_delivered::name;
+const __FlashStringHelper *const thermal_delivered::name = reinterpret_cast<const __FlashStringHelper *>(&thermal_delivered::name_progmem);
 
 constexpr ObisId water_device_type::id;
 constexpr char water_device_type::name_progmem[];
-constexpr const __FlashStringHelper *water_device_type::name;
+const __FlashStringHelper *const water_device_type::name = reinterpret_cast<const __FlashStringHelper *>(&water_device_type::name_progmem);
 
 constexpr ObisId water_equipment_id::id;
 constexpr char water_equipment_id::name_progmem[];
-constexpr const __FlashStringHelper *water_equipment_id::name;
+const __FlashStringHelper *const water_equipment_id::name = reinterpret_cast<const __FlashStringHelper *>(&water_equipment_id::name_progmem);
 
 constexpr ObisId water_valve_position::id;
 constexpr char water_valve_position::name_progmem[];
-constexpr const __FlashStringHelper *water_valve_position::name;
+const __FlashStringHelper *const water_valve_position::name = reinterpret_cast<const __FlashStringHelper *>(&water_valve_position::name_progmem);
 
 constexpr ObisId water_delivered::id;
 constexpr char water_delivered::name_progmem[];
-constexpr const __FlashStringHelper *water_delivered::name;
+const __FlashStringHelper *const water_delivered::name = reinterpret_cast<const __FlashStringHelper *>(&water_delivered::name_progmem);
 
 constexpr ObisId sub_device_type::id;
 constexpr char sub_device_type::name_progmem[];
-constexpr const __FlashStringHelper *sub_device_type::name;
+const __FlashStringHelper *const sub_device_type::name = reinterpret_cast<const __FlashStringHelper *>(&sub_device_type::name_progmem);
 
 constexpr ObisId sub_equipment_id::id;
 constexpr char sub_equipment_id::name_progmem[];
-constexpr const __FlashStringHelper *sub_equipment_id::name;
+const __FlashStringHelper *const sub_equipment_id::name = reinterpret_cast<const __FlashStringHelper *>(&sub_equipment_id::name_progmem);
 
 constexpr ObisId sub_valve_position::id;
 constexpr char sub_valve_position::name_progmem[];
-constexpr const __FlashStringHelper *sub_valve_position::name;
+const __FlashStringHelper *const sub_valve_position::name = reinterpret_cast<const __FlashStringHelper *>(&sub_valve_position::name_progmem);
 
 constexpr ObisId sub_delivered::id;
 constexpr char sub_delivered::name_progmem[];
-constexpr const __FlashStringHelper *sub_delivered::name;
+const __FlashStringHelper *const sub_delivered::name = reinterpret_cast<const __FlashStringHelper *>(&sub_delivered::name_progmem);
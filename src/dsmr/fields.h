@@ -42,8 +42,6 @@ namespace dsmr
   template <typename T>
   struct ParsedField
   {
-    template <typename F>
-    void apply(F &f) { f.apply(*static_cast<T *>(this)); }
     // By defaults, fields have no unit
     static const char *unit() { return ""; }
   };
@@ -53,10 +51,7 @@ namespace dsmr
   {
     ParseResult<void> parse(const char *str, const char *end)
     {
-      ParseResult<String> res = StringParser::parse_string(minlen, maxlen, str, end);
-      if (!res.err)
-        static_cast<T *>(this)->val() = res.result;
-      return res;
+      return StringParser::parse_string(static_cast<T *>(this)->val(), minlen, maxlen, str, end);
     }
   };
 
@@ -97,7 +92,7 @@ namespace dsmr
   {
     ParseResult<void> parse(const char *str, const char *end)
     {
-      ParseResult<uint32_t> res = NumParser::parse(3, _unit, str, end);
+      ParseResult<uint32_t> res = NumParser::parse<3, _unit>(str, end);
       if (!res.err)
         static_cast<T *>(this)->val()._value = res.result;
       return res;
@@ -109,7 +104,7 @@ namespace dsmr
 
   struct TimestampedFixedValue : public FixedValue
   {
-    String timestamp;
+    FieldString<13> timestamp;
   };
 
   // Some numerical values are prefixed with a timestamp. This is simply
@@ -120,12 +115,10 @@ namespace dsmr
     ParseResult<void> parse(const char *str, const char *end)
     {
       // First, parse timestamp
-      ParseResult<String> res = StringParser::parse_string(13, 13, str, end);
+      ParseResult<void> res = StringParser::parse_string(static_cast<T *>(this)->val().timestamp, 13, 13, str, end);
       if (res.err)
         return res;
 
-      static_cast<T *>(this)->val().timestamp = res.result;
-
       // Which is immediately followed by the numerical value
       return FixedField<T, _unit, _int_unit>::parse(res.next, end);
     }
@@ -137,7 +130,7 @@ namespace dsmr
   {
     ParseResult<void> parse(const char *str, const char *end)
     {
-      ParseResult<uint32_t> res = NumParser::parse(0, _unit, str, end);
+      ParseResult<uint32_t> res = NumParser::parse<0, _unit>(str, end);
       if (!res.err)
         static_cast<T *>(this)->val() = res.result;
       return res;
@@ -147,14 +140,18 @@ namespace dsmr
   };
 
   // A RawField is not parsed, the entire value (including any
-  // parenthesis around it) is returned as a string.
-  template <typename T>
+  // parenthesis around it) is returned as a string. The maxlen is the
+  // capacity to use with FieldString, it is only enforced (by
+  // assign_string) when the string storage has a fixed capacity. It
+  // defaults to 0 (unknown), for fields that store a String.
+  template <typename T, size_t maxlen = 0>
   struct RawField : ParsedField<T>
   {
     ParseResult<void> parse(const char *str, const char *end)
     {
       // Just copy the string verbatim value without any parsing
-      concat_hack(static_cast<T *>(this)->val(), str, end - str);
+      if (!assign_string(static_cast<T *>(this)->val(), str, end - str))
+        return ParseResult<void>().fail(ParseError::INVALID_STRING_LENGTH, str);
       return ParseResult<void>().until(end);
     }
   };
@@ -197,27 +194,25 @@ namespace dsmr
   struct fieldname : field_t<fieldname, ##field_args>                                                                \
   {                                                                                                                  \
     value_t fieldname;                                                                                               \
-    bool fieldname##_present = false;                                                                                \
     static constexpr ObisId id = obis;                                                                               \
     static constexpr char name_progmem[] DSMR_PROGMEM = #fieldname;                                                  \
-    static constexpr const __FlashStringHelper *name = reinterpret_cast<const __FlashStringHelper *>(&name_progmem); \
+    static const __FlashStringHelper *const name;                                                                    \
     value_t &val() { return fieldname; }                                                                             \
-    bool &present() { return fieldname##_present; }                                                                  \
   }
 
     /* Meter identification. This is not a normal field, but a
  * specially-formatted first line of the message */
-    DEFINE_FIELD(identification, String, ObisId(255, 255, 255, 255, 255, 255), RawField);
+    DEFINE_FIELD(identification, FieldString<96>, ObisId(255, 255, 255, 255, 255, 255), RawField, 96);
 
     /* Version information for P1 output */
-    DEFINE_FIELD(p1_version, String, ObisId(1, 3, 0, 2, 8), StringField, 2, 2);
-    DEFINE_FIELD(p1_version_be, String, ObisId(0, 0, 96, 1, 4), StringField, 2, 2);
+    DEFINE_FIELD(p1_version, FieldString<2>, ObisId(1, 3, 0, 2, 8), StringField, 2, 2);
+    DEFINE_FIELD(p1_version_be, FieldString<2>, ObisId(0, 0, 96, 1, 4), StringField, 2, 2);
 
     /* Date-time stamp of the P1 message */
-    DEFINE_FIELD(timestamp, String, ObisId(0, 0, 1, 0, 0), TimestampField);
+    DEFINE_FIELD(timestamp, FieldString<13>, ObisId(0, 0, 1, 0, 0), TimestampField);
 
     /* Equipment identifier */
-    DEFINE_FIELD(equipment_id, String, ObisId(0, 0, 96, 1, 1), StringField, 0, 96);
+    DEFINE_FIELD(equipment_id, FieldString<96>, ObisId(0, 0, 96, 1, 1), StringField, 0, 96);
 
     /* Meter Reading electricity delivered to client (Special for Lux) in 0,001 kWh */
     DEFINE_FIELD(energy_delivered_lux, FixedValue, ObisId(1, 0, 1, 8, 0), FixedField, units::kWh, units::Wh);
@@ -241,7 +236,7 @@ namespace dsmr
     /* Tariff indicator electricity. The tariff indicator can also be used
  * to switch tariff dependent loads e.g boilers. This is the
  * responsibility of the P1 user */
-    DEFINE_FIELD(electricity_tariff, String, ObisId(0, 0, 96, 14, 0), StringField, 4, 4);
+    DEFINE_FIELD(electricity_tariff, FieldString<4>, ObisId(0, 0, 96, 14, 0), StringField, 4, 4);
 
     /* Actual electricity power delivered (+P) in 1 Watt resolution */
     DEFINE_FIELD(power_delivered, FixedValue, ObisId(1, 0, 1, 7, 0), FixedField, units::kW, units::W);
@@ -265,8 +260,12 @@ namespace dsmr
     /* Number of long power failures in any phase */
     DEFINE_FIELD(electricity_long_failures, uint32_t, ObisId(0, 0, 96, 7, 9), IntField, units::none);
 
-    /* Power Failure Event Log (long power failures) */
-    DEFINE_FIELD(electricity_failure_log, String, ObisId(1, 0, 99, 97, 0), RawField);
+    /* Power Failure Event Log (long power failures). Holds up to 10
+ * events: "(10)(0-0:96.7.19)" followed by "(YYMMDDhhmmssX)(0000000000*s)"
+ * per event, so the raw value is at most 17 + 10 * 29 = 307 characters.
+ * With fixed capacity string storage, values over 320 characters are
+ * rejected. */
+    DEFINE_FIELD(electricity_failure_log, FieldString<320>, ObisId(1, 0, 99, 97, 0), RawField, 320);
 
     /* Number of voltage sags in phase L1 */
     DEFINE_FIELD(electricity_sags_l1, uint32_t, ObisId(1, 0, 32, 32, 0), IntField, units::none);
@@ -284,10 +283,10 @@ namespace dsmr
 
     /* Text message codes: numeric 8 digits (Note: Missing from 5.0 spec)
  * */
-    DEFINE_FIELD(message_short, String, ObisId(0, 0, 96, 13, 1), StringField, 0, 16);
+    DEFINE_FIELD(message_short, FieldString<16>, ObisId(0, 0, 96, 13, 1), StringField, 0, 16);
     /* Text message max 2048 characters (Note: Spec says 1024 in comment and
  * 2048 in format spec, so we stick to 2048). */
-    DEFINE_FIELD(message_long, String, ObisId(0, 0, 96, 13, 0), StringField, 0, 2048);
+    DEFINE_FIELD(message_long, FieldString<2048>, ObisId(0, 0, 96, 13, 0), StringField, 0, 2048);
 
     /* Instantaneous voltage L1 in 0.1V resolution (Note: Spec says V
  * resolution in comment, but 0.1V resolution in format spec. Added in
@@ -347,9 +346,9 @@ namespace dsmr
     DEFINE_FIELD(gas_device_type, uint16_t, ObisId(0, GAS_MBUS_ID, 24, 1, 0), IntField, units::none);
 
     /* Equipment identifier (Gas) */
-    DEFINE_FIELD(gas_equipment_id, String, ObisId(0, GAS_MBUS_ID, 96, 1, 0), StringField, 0, 96);
+    DEFINE_FIELD(gas_equipment_id, FieldString<96>, ObisId(0, GAS_MBUS_ID, 96, 1, 0), StringField, 0, 96);
     /* Equipment identifier (Gas) BE */
-    DEFINE_FIELD(gas_equipment_id_be, String, ObisId(0, GAS_MBUS_ID, 96, 1, 1), StringField, 0, 96);
+    DEFINE_FIELD(gas_equipment_id_be, FieldString<96>, ObisId(0, GAS_MBUS_ID, 96, 1, 1), StringField, 0, 96);
 
     /* Valve position Gas (on/off/released) (Note: Removed in 4.0.7 / 4.2.2 / 5.0). */
     DEFINE_FIELD(gas_valve_position, uint8_t, ObisId(0, GAS_MBUS_ID, 24, 4, 0), IntField, units::none);
@@ -367,7 +366,7 @@ namespace dsmr
     DEFINE_FIELD(thermal_device_type, uint16_t, ObisId(0, THERMAL_MBUS_ID, 24, 1, 0), IntField, units::none);
 
     /* Equipment identifier (Thermal: heat or cold) */
-    DEFINE_FIELD(thermal_equipment_id, String, ObisId(0, THERMAL_MBUS_ID, 96, 1, 0), StringField, 0, 96);
+    DEFINE_FIELD(thermal_equipment_id, FieldString<96>, ObisId(0, THERMAL_MBUS_ID, 96, 1, 0), StringField, 0, 96);
 
     /* Valve position (on/off/released) (Note: Removed in 4.0.7 / 4.2.2 / 5.0). */
     DEFINE_FIELD(thermal_valve_position, uint8_t, ObisId(0, THERMAL_MBUS_ID, 24, 4, 0), IntField, units::none);
@@ -381,7 +380,7 @@ namespace dsmr
     DEFINE_FIELD(water_device_type, uint16_t, ObisId(0, WATER_MBUS_ID, 24, 1, 0), IntField, units::none);
 
     /* Equipment identifier (Thermal: heat or cold) */
-    DEFINE_FIELD(water_equipment_id, String, ObisId(0, WATER_MBUS_ID, 96, 1, 0), StringField, 0, 96);
+    DEFINE_FIELD(water_equipment_id, FieldString<96>, ObisId(0, WATER_MBUS_ID, 96, 1, 0), StringField, 0, 96);
 
     /* Valve position (on/off/released) (Note: Removed in 4.0.7 / 4.2.2 / 5.0). */
     DEFINE_FIELD(water_valve_position, uint8_t, ObisId(0, WATER_MBUS_ID, 24, 4, 0), IntField, units::none);
@@ -395,7 +394,7 @@ namespace dsmr
     DEFINE_FIELD(sub_device_type, uint16_t, ObisId(0, SUB_MBUS_ID, 24, 1, 0), IntField, units::none);
 
     /* Equipment identifier (Thermal: heat or cold) */
-    DEFINE_FIELD(sub_equipment_id, String, ObisId(0, SUB_MBUS_ID, 96, 1, 0), StringField, 0, 96);
+    DEFINE_FIELD(sub_equipment_id, FieldString<96>, ObisId(0, SUB_MBUS_ID, 96, 1, 0), StringField, 0, 96);
 
     /* Valve position (on/off/released) (Note: Removed in 4.0.7 / 4.2.2 / 5.0). */
     DEFINE_FIELD(sub_valve_position, uint8_t, ObisId(0, SUB_MBUS_ID, 24, 4, 0), IntField, units::none);
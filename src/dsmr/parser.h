@@ -31,11 +31,124 @@
 #pragma once
 
 #include "crc16.h"
+#include "scan.h"
 #include "util.h"
 
+// When enabled, ParsedData::parse_line looks up the field for an OBIS id
+// using a binary search in a table sorted at compiletime, instead of
+// comparing against every field in turn. The tables cost RAM on AVR and
+// ESP8266 (where constant data is copied to RAM unless it is PROGMEM),
+// so there the linear search is used by default.
+#ifndef DSMR_SORTED_DISPATCH
+#if defined(__AVR__) || defined(ARDUINO_ARCH_ESP8266)
+#define DSMR_SORTED_DISPATCH 0
+#else
+#define DSMR_SORTED_DISPATCH 1
+#endif
+#endif
+
 namespace dsmr
 {
 
+  /**
+ * Compiletime sequence of indices, for expanding over the fields of a
+ * ParsedData.
+ */
+  template <size_t... Is>
+  struct _IndexSeq
+  {
+  };
+
+  template <size_t N, size_t... Is>
+  struct _MakeIndexSeq : _MakeIndexSeq<N - 1, N - 1, Is...>
+  {
+  };
+
+  template <size_t... Is>
+  struct _MakeIndexSeq<0, Is...>
+  {
+    typedef _IndexSeq<Is...> type;
+  };
+
+  // Number of keys in keys[0..n) that sort before keys[i]. Equal keys
+  // are ordered by their index, so the ranks of all keys are unique.
+  constexpr size_t _obis_rank(const uint64_t *keys, size_t n, size_t i, size_t j = 0)
+  {
+    return j == n ? 0 : (keys[j] < keys[i] || (j < i && keys[j] == keys[i])) + _obis_rank(keys, n, i, j + 1);
+  }
+
+  // Index in ranks (as computed by _obis_rank for each key) of the given
+  // rank
+  constexpr size_t _obis_with_rank(const size_t *ranks, size_t rank, size_t i = 0)
+  {
+    return ranks[i] == rank ? i : _obis_with_rank(ranks, rank, i + 1);
+  }
+
+  /**
+ * Lookup table from OBIS id key to field parse function for the fields
+ * Fs of the ParsedData Data, sorted by key at compiletime.
+ */
+  template <typename Data, typename Seq, typename... Fs>
+  struct _ObisDispatch;
+
+  template <typename Data, size_t... Is, typename... Fs>
+  struct _ObisDispatch<Data, _IndexSeq<Is...>, Fs...>
+  {
+    typedef ParseResult<void> (*Handler)(Data *, const char *, const char *);
+
+    static constexpr size_t size = sizeof...(Fs);
+    static constexpr uint64_t keys[] = {Fs::id.key()...};
+    static constexpr Handler handlers[] = {&Data::template parse_field<Fs>...};
+    // Ranking each key once keeps this O(n^2) constexpr calls
+    static constexpr size_t ranks[] = {_obis_rank(keys, size, Is)...};
+    static constexpr uint64_t sorted_keys[] = {keys[_obis_with_rank(ranks, Is)]...};
+    static constexpr Handler sorted_handlers[] = {handlers[_obis_with_rank(ranks, Is)]...};
+
+    static ParseResult<void> parse_line(Data *data, uint64_t key, const char *str, const char *end)
+    {
+      // Find the first field with a key that is not smaller than the
+      // one searched for. With duplicate ids, this finds the one listed
+      // first, just like the linear search does.
+      size_t lo = 0, hi = size;
+      while (lo < hi)
+      {
+        size_t mid = (lo + hi) / 2;
+        if (sorted_keys[mid] < key)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      if (lo < size && sorted_keys[lo] == key)
+        return sorted_handlers[lo](data, str, end);
+
+      // No matching handler, see _LinearDispatch<Data>::parse_line
+      return ParseResult<void>().until(str);
+    }
+  };
+
+  // Without fields, there is nothing to look up (and zero-length arrays
+  // are not allowed)
+  template <typename Data>
+  struct _ObisDispatch<Data, _IndexSeq<>>
+  {
+    static ParseResult<void> parse_line(Data * /* data */, uint64_t /* key */, const char *str, const char * /* end */)
+    {
+      // No matching handler, see _LinearDispatch<Data>::parse_line
+      return ParseResult<void>().until(str);
+    }
+  };
+
+  template <typename Data, size_t... Is, typename... Fs>
+  constexpr uint64_t _ObisDispatch<Data, _IndexSeq<Is...>, Fs...>::keys[];
+  template <typename Data, size_t... Is, typename... Fs>
+  constexpr typename _ObisDispatch<Data, _IndexSeq<Is...>, Fs...>::Handler _ObisDispatch<Data, _IndexSeq<Is...>, Fs...>::handlers[];
+  template <typename Data, size_t... Is, typename... Fs>
+  constexpr size_t _ObisDispatch<Data, _IndexSeq<Is...>, Fs...>::ranks[];
+  template <typename Data, size_t... Is, typename... Fs>
+  constexpr uint64_t _ObisDispatch<Data, _IndexSeq<Is...>, Fs...>::sorted_keys[];
+  template <typename Data, size_t... Is, typename... Fs>
+  constexpr typename _ObisDispatch<Data, _IndexSeq<Is...>, Fs...>::Handler _ObisDispatch<Data, _IndexSeq<Is...>, Fs...>::sorted_handlers[];
+
   /**
  * ParsedData is a template for the result of parsing a Dsmr P1 message.
  * You pass the fields you want to add to it as template arguments.
@@ -64,84 +177,270 @@ namespace dsmr
   struct ParsedData;
 
   /**
- * Base case: No fields present.
+ * Index of field F in the list of fields Ts, at compiletime.
+ */
+  template <typename F, typename... Ts>
+  struct _FieldIndex;
+
+  template <typename F, typename... Ts>
+  struct _FieldIndex<F, F, Ts...>
+  {
+    static const size_t value = 0;
+  };
+
+  template <typename F, typename T, typename... Ts>
+  struct _FieldIndex<F, T, Ts...>
+  {
+    static const size_t value = 1 + _FieldIndex<F, Ts...>::value;
+  };
+
+  template <typename... Ts>
+  struct _TypeList
+  {
+  };
+
+  template <typename A, typename B>
+  struct _Concat;
+
+  template <typename... As, typename... Bs>
+  struct _Concat<_TypeList<As...>, _TypeList<Bs...>>
+  {
+    typedef _TypeList<As..., Bs...> type;
+  };
+
+  template <bool cond, typename A, typename B>
+  struct _Conditional
+  {
+    typedef A type;
+  };
+
+  template <typename A, typename B>
+  struct _Conditional<false, A, B>
+  {
+    typedef B type;
+  };
+
+  // Alignments above 8 are rare, so they are grouped with 8
+  constexpr size_t _align_group(size_t align) { return align > 8 ? 8 : align; }
+
+  /**
+ * The fields in Ts that are in the given alignment group, in the same
+ * order.
+ */
+  template <size_t align, typename... Ts>
+  struct _AlignedFields
+  {
+    typedef _TypeList<> type;
+  };
+
+  template <size_t align, typename T, typename... Ts>
+  struct _AlignedFields<align, T, Ts...>
+  {
+    typedef typename _Concat<
+        typename _Conditional<_align_group(alignof(T)) == align, _TypeList<T>, _TypeList<>>::type,
+        typename _AlignedFields<align, Ts...>::type>::type type;
+  };
+
+  /**
+ * Class that extends all fields in the list, to store their values.
  */
-  template <>
-  struct ParsedData<>
+  template <typename List>
+  struct _FieldStorage;
+
+  template <typename... Ts>
+  struct _FieldStorage<_TypeList<Ts...>> : public Ts...
+  {
+  };
+
+  /**
+ * Storage for the fields Ts, with the fields grouped by alignment
+ * (largest first), so there is no padding between them.
+ */
+  template <typename... Ts>
+  struct _SortedFieldStorage
+      : _FieldStorage<typename _Concat<
+            typename _Concat<typename _AlignedFields<8, Ts...>::type, typename _AlignedFields<4, Ts...>::type>::type,
+            typename _Concat<typename _AlignedFields<2, Ts...>::type,
+                             typename _AlignedFields<1, Ts...>::type>::type>::type>
+  {
+  };
+
+  /**
+ * Reference to a single bit in the present bits of a ParsedData, that
+ * converts to a bool and can be assigned to. This is passed to the
+ * functor in applyEach.
+ */
+  class PresentBit
   {
-    ParseResult<void> __attribute__((__always_inline__))
-    parse_line_inlined(const ObisId & /* id */, const char *str, const char * /* end */)
+  public:
+    PresentBit(uint8_t *byte, uint8_t mask) : byte(byte), mask(mask) {}
+    // Copies refer to the same bit (assignment assigns the bit instead)
+    PresentBit(const PresentBit &) = default;
+
+    operator bool() const { return *this->byte & this->mask; }
+
+    PresentBit &operator=(bool present)
+    {
+      if (present)
+        *this->byte |= this->mask;
+      else
+        *this->byte &= ~this->mask;
+      return *this;
+    }
+
+    PresentBit &operator=(const PresentBit &other) { return *this = (bool)other; }
+
+  protected:
+    uint8_t *byte;
+    uint8_t mask;
+  };
+
+  /**
+ * Calls f.apply(item, present) when F has such a method, or else the
+ * single argument f.apply(item) that applyEach used before the present
+ * flags were moved into a bitmap. The int/long argument makes the first
+ * overload preferred when both are viable.
+ */
+  template <typename F, typename Item>
+  inline auto __attribute__((__always_inline__)) _apply_field(F &f, Item &item, PresentBit present, int)
+      -> decltype(f.apply(item, present), void())
+  {
+    f.apply(item, present);
+  }
+
+  template <typename F, typename Item>
+  inline void __attribute__((__always_inline__)) _apply_field(F &f, Item &item, PresentBit /* present */, long)
+  {
+    f.apply(item);
+  }
+
+  /**
+ * Linear search for the field with the given id key (see
+ * ObisId::key()), by comparing against every field in turn. Used when
+ * DSMR_SORTED_DISPATCH is disabled.
+ */
+  template <typename Data, typename... Ts>
+  struct _LinearDispatch
+  {
+    static ParseResult<void> __attribute__((__always_inline__))
+    parse_line(Data * /* data */, uint64_t /* key */, const char *str, const char * /* end */)
     {
       // Parsing succeeded, but found no matching handler (so return
       // set the next pointer to show nothing was parsed).
       return ParseResult<void>().until(str);
     }
 
-    template <typename F>
-    void __attribute__((__always_inline__)) applyEach_inlined(F && /* f */)
+    static constexpr bool has_field(uint64_t /* key */) { return false; }
+  };
+
+  template <typename Data, typename T, typename... Ts>
+  struct _LinearDispatch<Data, T, Ts...>
+  {
+    static ParseResult<void> __attribute__((__always_inline__))
+    parse_line(Data *data, uint64_t key, const char *str, const char *end)
     {
-      // Nothing to do
+      if (key == T::id.key())
+        return Data::template parse_field<T>(data, str, end);
+      return _LinearDispatch<Data, Ts...>::parse_line(data, key, str, end);
     }
 
-    bool all_present_inlined() { return true; }
+    static constexpr bool has_field(uint64_t key) { return key == T::id.key() || _LinearDispatch<Data, Ts...>::has_field(key); }
   };
 
-  // Do not use F() for multiply-used strings (including strings used from
-  // multiple template instantiations), that would result in multiple
-  // instances of the string in the binary
-  static constexpr char DUPLICATE_FIELD[] DSMR_PROGMEM = "Duplicate field";
-
-  /**
- * General case: At least one typename is passed.
- */
-  template <typename T, typename... Ts>
-  struct ParsedData<T, Ts...> : public T, ParsedData<Ts...>
+  template <typename... Ts>
+  struct ParsedData : public _SortedFieldStorage<Ts...>
   {
+    /**
+   * Whether each field is present, one bit per field in the order of
+   * Ts, least significant bit first. Use present() to access these.
+   */
+    uint8_t _present[(sizeof...(Ts) + 7) / 8 + (sizeof...(Ts) == 0)] = {};
+
     /**
    * This method is used by the parser to parse a single line. The
-   * OBIS id of the line is passed, and this method recursively finds a
-   * field with a matching id. If any, it calls it's parse method, which
-   * parses the value and stores it in the field.
+   * OBIS id of the line is passed as its packed key (see
+   * ObisId::key()), and this method finds a field with a matching id.
+   * If any, it calls it's parse method, which parses the value and
+   * stores it in the field.
    */
+    ParseResult<void> parse_line(uint64_t key, const char *str, const char *end)
+    {
+#if DSMR_SORTED_DISPATCH
+      typedef typename _MakeIndexSeq<sizeof...(Ts)>::type Seq;
+      return _ObisDispatch<ParsedData, Seq, Ts...>::parse_line(this, key, str, end);
+#else
+      return _LinearDispatch<ParsedData, Ts...>::parse_line(this, key, str, end);
+#endif
+    }
+
     ParseResult<void> parse_line(const ObisId &id, const char *str, const char *end)
     {
-      return parse_line_inlined(id, str, end);
+      return this->parse_line(id.key(), str, end);
     }
 
     /**
-   * always_inline version of parse_line. This is a separate method, to
-   * allow recursively inlining all calls, but still have a non-inlined
-   * top-level parse_line method.
+   * Parses the value for field F, which must be one of the fields of
+   * this ParsedData. Used by both the linear and the sorted lookup.
    */
-    ParseResult<void> __attribute__((__always_inline__))
-    parse_line_inlined(const ObisId &id, const char *str, const char *end)
+    template <typename F>
+    static ParseResult<void> parse_field(ParsedData *data, const char *str, const char *end)
     {
-      if (id == T::id)
-      {
-        if (T::present())
-          return ParseResult<void>().fail((const __FlashStringHelper *)DUPLICATE_FIELD, str);
-        T::present() = true;
-        return T::parse(str, end);
-      }
-      return ParsedData<Ts...>::parse_line_inlined(id, str, end);
+      PresentBit present = data->present<F>();
+      if (present)
+        return ParseResult<void>().fail(ParseError::DUPLICATE_FIELD, str);
+      present = true;
+      F *field = data;
+      return field->parse(str, end);
     }
 
+    /**
+   * Returns whether field F is present. The result converts to bool and
+   * can be assigned to, to change whether F is present.
+   */
     template <typename F>
-    void applyEach(F &&f) { applyEach_inlined(f); }
+    PresentBit present()
+    {
+      const size_t index = _FieldIndex<F, Ts...>::value;
+      return PresentBit(&this->_present[index / 8], 1 << (index % 8));
+    }
 
     template <typename F>
-    void __attribute__((__always_inline__)) applyEach_inlined(F &&f)
+    bool present() const
     {
-      T::apply(f);
-      return ParsedData<Ts...>::applyEach_inlined(f);
+      const size_t index = _FieldIndex<F, Ts...>::value;
+      return this->_present[index / 8] & (1 << (index % 8));
+    }
+
+    /**
+   * Calls f.apply(field, present) for each field, in the order of Ts.
+   * present is a PresentBit for the field. For compatibility, F can
+   * also have just apply(field), but fields no longer have a present()
+   * method, so that cannot tell whether the field is present.
+   */
+    template <typename F>
+    void applyEach(F &&f)
+    {
+      int expand[] = {0, (_apply_field(f, static_cast<Ts &>(*this), this->present<Ts>(), 0), 0)...};
+      (void)expand;
     }
 
     /**
    * Returns true when all defined fields are present.
    */
-    bool all_present() { return all_present_inlined(); }
+    bool all_present() const
+    {
+      for (size_t i = 0; i < sizeof...(Ts) / 8; ++i)
+        if (this->_present[i] != 0xff)
+          return false;
+      return sizeof...(Ts) % 8 == 0 ||
+             this->_present[sizeof...(Ts) / 8] == (1 << (sizeof...(Ts) % 8)) - 1;
+    }
 
-    bool all_present_inlined() { return T::present() && ParsedData<Ts...>::all_present_inlined(); }
+    /**
+   * Returns true when one of the fields has the given id.
+   */
+    static constexpr bool has_field(uint64_t key) { return _LinearDispatch<ParsedData, Ts...>::has_field(key); }
+    static constexpr bool has_field(const ObisId &id) { return has_field(id.key()); }
   };
 
   struct StringParser
@@ -149,69 +448,92 @@ namespace dsmr
     static ParseResult<String> parse_string(size_t min, size_t max, const char *str, const char *end)
     {
       ParseResult<String> res;
+      ParseResult<void> tmp = parse_string(res.result, min, max, str, end);
+      if (tmp.err)
+        return tmp;
+      return res.until(tmp.next);
+    }
+
+    /**
+   * Parse a string between parenthesis and store it into dest, which
+   * can be any type supported by assign_string. dest is only modified
+   * when parsing succeeds.
+   */
+    template <typename S>
+    static ParseResult<void> parse_string(S &dest, size_t min, size_t max, const char *str, const char *end)
+    {
+      ParseResult<void> res;
       if (str >= end || *str != '(')
-        return res.fail(F("Missing ("), str);
+        return res.fail(ParseError::MISSING_OPEN_PAREN, str);
 
       const char *str_start = str + 1; // Skip (
-      const char *str_end = str_start;
-
-      while (str_end < end && *str_end != ')')
-        ++str_end;
+      const char *str_end = (const char *)memchr(str_start, ')', end - str_start);
 
-      if (str_end == end)
-        return res.fail(F("Missing )"), str_end);
+      if (!str_end)
+        return res.fail(ParseError::MISSING_CLOSE_PAREN, end);
 
       size_t len = str_end - str_start;
-      if (len < min || len > max)
-        return res.fail(F("Invalid string length"), str_start);
-
-      concat_hack(res.result, str_start, len);
+      if (len < min || len > max || !assign_string(dest, str_start, len))
+        return res.fail(ParseError::INVALID_STRING_LENGTH, str_start);
 
       return res.until(str_end + 1); // Skip )
     }
   };
 
-  // Do not use F() for multiply-used strings (including strings used from
-  // multiple template instantiations), that would result in multiple
-  // instances of the string in the binary
-  static constexpr char INVALID_NUMBER[] DSMR_PROGMEM = "Invalid number";
-  static constexpr char INVALID_UNIT[] DSMR_PROGMEM = "Invalid unit";
+  // Length of a string, at compiletime when possible
+  constexpr size_t _cstrlen(const char *str, size_t i = 0) { return str[i] ? _cstrlen(str, i + 1) : i; }
 
   struct NumParser
   {
     static ParseResult<uint32_t> parse(size_t max_decimals, const char *unit, const char *str, const char *end)
+    {
+      return parse_number(max_decimals, unit, unit ? strlen(unit) : 0, str, end);
+    }
+
+    /**
+   * Same as above, but with the number of decimals and the unit known
+   * at compiletime, so the unit is compared using a fixed length.
+   */
+    template <size_t max_decimals, const char *unit>
+    static ParseResult<uint32_t> parse(const char *str, const char *end)
+    {
+#ifdef __AVR__
+      // Share a single copy of the parser, to save flash
+      return parse(max_decimals, unit, str, end);
+#else
+      return parse_number(max_decimals, unit, _cstrlen(unit), str, end);
+#endif
+    }
+
+  protected:
+    static bool is_digit(char c) { return (uint8_t)(c - '0') < 10; }
+
+    static ParseResult<uint32_t> __attribute__((__always_inline__))
+    parse_number(size_t max_decimals, const char *unit, size_t unit_len, const char *str, const char *end)
     {
       ParseResult<uint32_t> res;
       if (str >= end || *str != '(')
-        return res.fail(F("Missing ("), str);
-
-      const char *num_start = str + 1; // Skip (
-      const char *num_end = num_start;
+        return res.fail(ParseError::MISSING_OPEN_PAREN, str);
 
-      uint32_t value = 0;
+      const char *num_end = str + 1; // Skip (
 
       // Parse integer part
-      while (num_end < end && !strchr("*.)", *num_end))
-      {
-        if (*num_end < '0' || *num_end > '9')
-          return res.fail((const __FlashStringHelper *)INVALID_NUMBER, num_end);
-        value *= 10;
-        value += *num_end - '0';
-        ++num_end;
-      }
+      uint32_t value = parse_digits(num_end, end);
+      if (num_end < end && !is_end_of_integer(*num_end))
+        return res.fail(ParseError::INVALID_NUMBER, num_end);
 
       // Parse decimal part, if any
       if (max_decimals && num_end < end && *num_end == '.')
       {
         ++num_end;
 
-        while (num_end < end && !strchr("*)", *num_end) && max_decimals--)
+        while (num_end < end && max_decimals && !is_end_of_decimals(*num_end))
         {
-          if (*num_end < '0' || *num_end > '9')
-            return res.fail((const __FlashStringHelper *)INVALID_NUMBER, num_end);
-          value *= 10;
-          value += *num_end - '0';
+          if (!is_digit(*num_end))
+            return res.fail(ParseError::INVALID_NUMBER, num_end);
+          value = value * 10 + (*num_end - '0');
           ++num_end;
+          --max_decimals;
         }
       }
 
@@ -219,37 +541,101 @@ namespace dsmr
       while (max_decimals--)
         value *= 10;
 
-      if (unit && *unit)
+      if (unit_len)
       {
         if (num_end >= end || *num_end != '*')
-          return res.fail(F("Missing unit"), num_end);
-        const char *unit_start = ++num_end; // skip *
-        while (num_end < end && *num_end != ')' && *unit)
-        {
-          if (*num_end++ != *unit++)
-            return res.fail((const __FlashStringHelper *)INVALID_UNIT, unit_start);
-        }
-        if (*unit)
-          return res.fail((const __FlashStringHelper *)INVALID_UNIT, unit_start);
+          return res.fail(ParseError::MISSING_UNIT, num_end);
+        ++num_end; // skip *
+        if ((size_t)(end - num_end) < unit_len || memcmp(num_end, unit, unit_len))
+          return res.fail(ParseError::INVALID_UNIT, num_end);
+        num_end += unit_len;
       }
 
       if (num_end >= end || *num_end != ')')
-        return res.fail(F("Extra data"), num_end);
+        return res.fail(ParseError::EXTRA_DATA, num_end);
 
       return res.succeed(value).until(num_end + 1); // Skip )
     }
+
+    // Characters that end the integer part of a number. A NUL also ends
+    // it (and is then reported as extra data).
+    static bool is_end_of_integer(char c) { return c == '*' || c == '.' || c == ')' || c == '\0'; }
+    static bool is_end_of_decimals(char c) { return c == '*' || c == ')' || c == '\0'; }
+
+    /**
+   * Parses the digits at str into a number, stopping at the first
+   * non-digit. Updates str to point to that non-digit (or end). Like
+   * value * 10 + digit, the result wraps around on overflow.
+   */
+    static uint32_t __attribute__((__always_inline__)) parse_digits(const char *&str, const char *end)
+    {
+      uint32_t value = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && !defined(__AVR__)
+      // Convert up to 8 digits at a time, using SWAR (SIMD within a
+      // register) on a 64-bit word holding 8 characters
+      static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+      while (end - str >= 8)
+      {
+        uint64_t chars;
+        memcpy(&chars, str, sizeof(chars));
+        // A byte is a digit when its high nibble is 3 and adding 6 does
+        // not change that. A carry out of a non-digit byte can only mess
+        // up the bytes after it, which are not used.
+        uint64_t non_digits = ((chars & 0xf0f0f0f0f0f0f0f0) ^ 0x3030303030303030) |
+                              (((chars + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) ^ 0x3030303030303030);
+        unsigned digits = non_digits ? __builtin_ctzll(non_digits) / 8 : 8;
+        if (digits == 0)
+          break;
+
+        // Keep just the digits, moved to the top bytes, so the bytes
+        // below them count as leading zeroes
+        uint64_t v = chars - 0x3030303030303030;
+        v <<= 8 * (8 - digits);
+        // Combine pairs of digits, then pairs of pairs, and so on. The
+        // first character (least significant byte) is the most
+        // significant digit.
+        v = (v * 10 + (v >> 8)) & 0x00ff00ff00ff00ff;
+        v = (v * 100 + (v >> 16)) & 0x0000ffff0000ffff;
+        v = (v * 10000 + (v >> 32)) & 0x00000000ffffffff;
+
+        value = value * pow10[digits] + (uint32_t)v;
+        str += digits;
+        if (digits < 8)
+          return value;
+      }
+#endif
+      while (str < end && is_digit(*str))
+      {
+        value = value * 10 + (*str - '0');
+        ++str;
+      }
+      return value;
+    }
   };
 
   struct ObisIdParser
   {
     static ParseResult<ObisId> parse(const char *str, const char *end)
     {
-      // Parse a Obis ID of the form 1-2:3.4.5.6
-      // Stops parsing on the first unrecognized character. Any unparsed
-      // parts are set to 255.
-      ParseResult<ObisId> res;
-      ObisId &id = res.result;
+      ParseResult<uint64_t> key = parse_key(str, end);
+      ParseResult<ObisId> res = key;
+      if (!key.err)
+        res.result = ObisId::from_key(key.result);
+      return res;
+    }
+
+    /**
+   * Parse an Obis ID of the form 1-2:3.4.5.6 into its packed key form
+   * (see ObisId::key()), building the key while parsing.
+   * Stops parsing on the first unrecognized character. Any unparsed
+   * parts are set to 255.
+   */
+    static ParseResult<uint64_t> parse_key(const char *str, const char *end)
+    {
+      ParseResult<uint64_t> res;
       res.next = str;
+      uint64_t key = 0;
+      unsigned value = 0;
       uint8_t part = 0;
       while (res.next < end)
       {
@@ -257,21 +643,14 @@ namespace dsmr
 
         if (c >= '0' && c <= '9')
         {
-          uint8_t digit = c - '0';
-          if (id.v[part] > 25 || (id.v[part] == 25 && digit > 5))
-            return res.fail(F("Obis ID has number over 255"), res.next);
-          id.v[part] = id.v[part] * 10 + digit;
+          value = value * 10 + (c - '0');
+          if (value > 255)
+            return res.fail(ParseError::OBIS_NUMBER_TOO_LARGE, res.next);
         }
-        else if (part == 0 && c == '-')
-        {
-          part++;
-        }
-        else if (part == 1 && c == ':')
-        {
-          part++;
-        }
-        else if (part > 1 && part < 5 && c == '.')
+        else if ((part == 0 && c == '-') || (part == 1 && c == ':') || (part > 1 && part < 5 && c == '.'))
         {
+          key = key << 8 | value;
+          value = 0;
           part++;
         }
         else
@@ -282,12 +661,13 @@ namespace dsmr
       }
 
       if (res.next == str)
-        return res.fail(F("OBIS id Empty"), str);
+        return res.fail(ParseError::OBIS_EMPTY, str);
 
+      key = key << 8 | value;
       for (++part; part < 6; ++part)
-        id.v[part] = 255;
+        key = key << 8 | 255;
 
-      return res;
+      return res.succeed(key);
     }
   };
 
@@ -303,7 +683,7 @@ namespace dsmr
       // This should never happen with the code in this library, but
       // check anyway
       if (str + CRC_LEN > end)
-        return res.fail(F("No checksum found"), str);
+        return res.fail(ParseError::NO_CHECKSUM, str);
 
       // A bit of a messy way to parse the checksum, but all
       // integer-parse functions assume nul-termination
@@ -315,13 +695,55 @@ namespace dsmr
 
       // See if all four bytes formed a valid number
       if (endp != buf + CRC_LEN)
-        return res.fail(F("Incomplete or malformed checksum"), str);
+        return res.fail(ParseError::MALFORMED_CHECKSUM, str);
 
       res.next = str + CRC_LEN;
       return res.succeed(check);
     }
   };
 
+  /**
+   * A CRC that is calculated over a message in parts, along with the
+   * position up to where it was calculated.
+   */
+  struct _CrcProgress
+  {
+    uint16_t crc;
+    const char *pos;
+
+    void update_to(const char *end)
+    {
+      this->crc = crc16_update(this->crc, this->pos, end - this->pos);
+      this->pos = end;
+    }
+  };
+
+  /**
+   * Where parsing the data part of a message continues, when parsing it
+   * a few lines at a time using P1Parser::parse_data_step().
+   */
+  struct DataCursor
+  {
+    // The start of the next line to parse
+    const char *pos;
+    // The ! before the checksum
+    const char *end;
+    // Whether the identification line was parsed
+    bool identified;
+
+    void start(const char *str, const char *end)
+    {
+      this->pos = str;
+      this->end = end;
+      this->identified = false;
+    }
+
+    bool done() const
+    {
+      return this->pos == this->end;
+    }
+  };
+
   struct P1Parser
   {
     /**
@@ -335,24 +757,31 @@ namespace dsmr
     {
       ParseResult<void> res;
       if (!n || str[0] != '/')
-        return res.fail(F("Data should start with /"), str);
+        return res.fail(ParseError::MISSING_START, str);
 
       // Skip /
       const char *data_start = str + 1;
 
       // Look for ! that terminates the data
-      const char *data_end = data_start;
-      uint16_t crc = _crc16_update(0, *str); // Include the / in CRC
-      while (data_end < str + n && *data_end != '!')
-      {
-        crc = _crc16_update(crc, *data_end);
-        ++data_end;
-      }
+#if DSMR_LINE_INDEX_SIZE > 0
+      // Index the lines and calculate the CRC along the way (including
+      // the /)
+      LineIndex index;
+      uint16_t crc = _crc16_update(0, '/');
+      const char *data_end = scan_data(data_start, str + n, &index, &crc);
+      if (!data_end)
+        return res.fail(ParseError::NO_CHECKSUM, str + n);
 
-      if (data_end >= str + n)
-        return res.fail(F("No checksum found"), data_end);
+      // Include the ! in the CRC
+      crc = _crc16_update(crc, '!');
+#else
+      const char *data_end = (const char *)memchr(data_start, '!', n - 1);
+      if (!data_end)
+        return res.fail(ParseError::NO_CHECKSUM, str + n);
 
-      crc = _crc16_update(crc, *data_end); // Include the ! in CRC
+      // Include both the / and the ! in the CRC
+      uint16_t crc = crc16_update(0, str, data_end + 1 - str);
+#endif
 
       ParseResult<uint16_t> check_res = CrcParser::parse(data_end + 1, str + n);
       if (check_res.err)
@@ -361,14 +790,101 @@ namespace dsmr
       // Check CRC
       if (check_res.result != crc)
       {
-        return res.fail(F("Checksum mismatch"), data_end + 1);
+        return res.fail(ParseError::CHECKSUM_MISMATCH, data_end + 1);
       }
 
+#if DSMR_LINE_INDEX_SIZE > 0
+      res = parse_lines(data, data_start, data_end, &index, unknown_error);
+#else
       res = parse_data(data, data_start, data_end, unknown_error);
+#endif
+      res.next = check_res.next;
+      return res;
+    }
+
+    /**
+   * Parse a complete P1 telegram, like parse(), but verify the checksum
+   * while parsing instead of before. Each line is checksummed right
+   * before it is parsed, into a copy of data, which is only copied back
+   * into data when the checksum matches. The result (including which
+   * error is returned when there are multiple problems) is the same as
+   * for parse(), but the message is read only once, and there is no
+   * separate pass over it before the first field can be parsed.
+   *
+   * This is only worth it when copying the ParsedData is cheap. When
+   * DSMR_LINE_INDEX_SIZE is 0, this just calls parse().
+   */
+    template <typename... Ts>
+    static ParseResult<void> parse_verify_later(ParsedData<Ts...> *data, const char *str, size_t n,
+                                                bool unknown_error = false)
+    {
+#if DSMR_LINE_INDEX_SIZE > 0
+      ParseResult<void> res;
+      if (!n || str[0] != '/')
+        return res.fail(ParseError::MISSING_START, str);
+
+      const char *data_start = str + 1;
+      LineIndex index;
+      const char *data_end = scan_data(data_start, str + n, &index, NULL);
+      if (!data_end)
+        return res.fail(ParseError::NO_CHECKSUM, str + n);
+
+      ParseResult<uint16_t> check_res = CrcParser::parse(data_end + 1, str + n);
+      if (check_res.err)
+        return check_res;
+
+      ParsedData<Ts...> staging(*data);
+      _CrcProgress crc = {_crc16_update(0, '/'), data_start};
+      res = parse_lines(&staging, data_start, data_end, &index, unknown_error, &crc);
+
+      // Include the rest of the data (if parsing stopped early) and the !
+      // in the CRC
+      crc.update_to(data_end + 1);
+      if (check_res.result != crc.crc)
+        return ParseResult<void>().fail(ParseError::CHECKSUM_MISMATCH, data_end + 1);
+
+      // Like parse(), a message with a correct checksum but invalid
+      // data leaves the fields parsed before the error in data
+      *data = staging;
       res.next = check_res.next;
       return res;
+#else
+      return parse(data, str, n, unknown_error);
+#endif
     }
 
+#if DSMR_LINE_INDEX_SIZE > 0
+    /**
+   * Scan the data part of a message, starting after the /, for lines
+   * into index. Returns the ! that ends the data, or NULL when there
+   * is none. If crc is not NULL, it is updated with all data before
+   * the !.
+   */
+    static const char *scan_data(const char *str, const char *end, LineIndex *index, uint16_t *crc)
+    {
+      const char *data_end;
+      if (crc)
+        data_end = scan_lines(str, end, index, crc);
+      else
+        data_end = scan_lines(str, end, index);
+
+      if (index->full)
+      {
+        // Scanned as much as fits in the index, find the end and
+        // checksum the rest
+        const char *scanned = data_end;
+        data_end = (const char *)memchr(scanned, '!', end - scanned);
+        if (data_end && crc)
+          *crc = crc16_update(*crc, scanned, data_end - scanned);
+      }
+      else if (data_end == end)
+      {
+        data_end = NULL;
+      }
+      return data_end;
+    }
+#endif
+
     /**
    * Parse the data part of a message. Str should point to the first
    * character after the leading /, end should point to the ! before the
@@ -378,6 +894,11 @@ namespace dsmr
     static ParseResult<void> parse_data(ParsedData<Ts...> *data, const char *str, const char *end,
                                         bool unknown_error = false)
     {
+#if DSMR_LINE_INDEX_SIZE > 0
+      LineIndex index;
+      scan_lines(str, end, &index);
+      return parse_lines(data, str, end, &index, unknown_error);
+#else
       ParseResult<void> res;
       // Split into lines and parse those
       const char *line_end = str, *line_start = str;
@@ -387,21 +908,7 @@ namespace dsmr
       {
         if (*line_end == '\r' || *line_end == '\n')
         {
-          // The first identification line looks like:
-          // XXX5<id string>
-          // The DSMR spec is vague on details, but in 62056-21, the X's
-          // are a three-leter (registerd) manufacturer ID, the id
-          // string is up to 16 chars of arbitrary characters and the
-          // '5' is a baud rate indication. 5 apparently means 9600,
-          // which DSMR 3.x and below used. It seems that DSMR 2.x
-          // passed '3' here (which is mandatory for "mode D"
-          // communication according to 62956-21), so we also allow
-          // that.
-          if (line_start + 3 >= line_end || (line_start[3] != '5' && line_start[3] != '3'))
-            return res.fail(F("Invalid identification string"), line_start);
-          // Offer it for processing using the all-ones Obis ID, which
-          // is not otherwise valid.
-          ParseResult<void> tmp = data->parse_line(ObisId(255, 255, 255, 255, 255, 255), line_start, line_end);
+          ParseResult<void> tmp = parse_identification(data, line_start, line_end);
           if (tmp.err)
             return tmp;
           line_start = ++line_end;
@@ -424,10 +931,132 @@ namespace dsmr
       }
 
       if (line_end != line_start)
-        return res.fail(F("Last dataline not CRLF terminated"), line_end);
+        return res.fail(ParseError::LINE_NOT_TERMINATED, line_end);
+
+      return res;
+#endif
+    }
+
+    /**
+   * Parse the data part of a message, like parse_data(), but parse at
+   * most max_lines (non-empty) lines, starting where the cursor points.
+   * The cursor should be started with the first character after the
+   * leading / and the ! before the checksum, and is advanced past the
+   * lines parsed. Call this until it returns an error or cursor->done()
+   * is true, which gives the same result as a single parse_data() call.
+   * Does not verify the checksum.
+   */
+    template <typename... Ts>
+    static ParseResult<void> parse_data_step(ParsedData<Ts...> *data, DataCursor *cursor, size_t max_lines,
+                                             bool unknown_error = false)
+    {
+      ParseResult<void> res;
+      const char *line_start = cursor->pos, *line_end = line_start;
+      size_t lines = 0;
+
+      while (line_end < cursor->end && lines < max_lines)
+      {
+        if (*line_end == '\r' || *line_end == '\n')
+        {
+          ParseResult<void> tmp;
+          if (cursor->identified)
+            tmp = parse_line(data, line_start, line_end, unknown_error);
+          else
+            tmp = parse_identification(data, line_start, line_end);
+          if (tmp.err)
+            return tmp;
+          cursor->identified = true;
+          if (line_end != line_start)
+            lines++;
+          line_start = line_end + 1;
+        }
+        line_end++;
+      }
+
+      // Stopping at max_lines leaves line_end at the start of the next
+      // line, so this only triggers at the end of the data
+      if (line_end != line_start)
+        return res.fail(ParseError::LINE_NOT_TERMINATED, line_end);
+
+      cursor->pos = line_start;
+      return res.until(line_start);
+    }
+
+#if DSMR_LINE_INDEX_SIZE > 0
+    /**
+   * Parse the data part of a message, like parse_data, using the line
+   * terminators that scan_lines() recorded in index for the data
+   * starting at str. If the index does not cover all data up to end, the
+   * rest is scanned (reusing index) while parsing.
+   *
+   * If crc is not NULL, each line (including its terminator) is added
+   * to it before parsing the line.
+   */
+    template <typename... Ts>
+    static ParseResult<void> parse_lines(ParsedData<Ts...> *data, const char *str, const char *end,
+                                         LineIndex *index, bool unknown_error = false,
+                                         _CrcProgress *crc = NULL)
+    {
+      ParseResult<void> res;
+      const char *line_start = str;
+      bool first = true;
+
+      while (true)
+      {
+        for (size_t i = 0; i < index->count; ++i)
+        {
+          const char *line_end = index->end(i);
+          if (crc)
+            crc->update_to(line_end + 1);
+          ParseResult<void> tmp;
+          if (first)
+            tmp = parse_identification(data, line_start, line_end);
+          else
+            tmp = parse_line(data, line_start, line_end, unknown_error);
+          if (tmp.err)
+            return tmp;
+          first = false;
+          line_start = line_end + 1;
+        }
+
+        if (index->stop >= end)
+          break;
+
+        // The index was full, or the scan stopped at a ! that is part of
+        // the data: scan the rest
+        scan_lines(index->full ? index->stop : index->stop + 1, end, index);
+      }
+
+      if (line_start != end)
+        return res.fail(ParseError::LINE_NOT_TERMINATED, end);
 
       return res;
     }
+#endif
+
+    /**
+   * Parse the identification line, the first line of a message (without
+   * the leading /).
+   */
+    template <typename Data>
+    static ParseResult<void> parse_identification(Data *data, const char *line, const char *end)
+    {
+      // The first identification line looks like:
+      // XXX5<id string>
+      // The DSMR spec is vague on details, but in 62056-21, the X's
+      // are a three-leter (registerd) manufacturer ID, the id
+      // string is up to 16 chars of arbitrary characters and the
+      // '5' is a baud rate indication. 5 apparently means 9600,
+      // which DSMR 3.x and below used. It seems that DSMR 2.x
+      // passed '3' here (which is mandatory for "mode D"
+      // communication according to 62956-21), so we also allow
+      // that.
+      if (line + 3 >= end || (line[3] != '5' && line[3] != '3'))
+        return ParseResult<void>().fail(ParseError::INVALID_IDENTIFICATION, line);
+      // Offer it for processing using the all-ones Obis ID, which
+      // is not otherwise valid.
+      return data->parse_line(ObisId(255, 255, 255, 255, 255, 255).key(), line, end);
+    }
 
     template <typename Data>
     static ParseResult<void> parse_line(Data *data, const char *line, const char *end, bool unknown_error)
@@ -436,7 +1065,7 @@ namespace dsmr
       if (line == end)
         return res;
 
-      ParseResult<ObisId> idres = ObisIdParser::parse(line, end);
+      ParseResult<uint64_t> idres = ObisIdParser::parse_key(line, end);
       if (idres.err)
         return idres;
 
@@ -448,9 +1077,9 @@ namespace dsmr
       // this field, that's ok. But if it did move, but not all the way
       // to the end, that's an error.
       if (datares.next != idres.next && datares.next != end)
-        return res.fail(F("Trailing characters on data line"), datares.next);
+        return res.fail(ParseError::TRAILING_CHARACTERS, datares.next);
       else if (datares.next == idres.next && unknown_error)
-        return res.fail(F("Unknown field"), line);
+        return res.fail(ParseError::UNKNOWN_FIELD, line);
 
       return res.until(end);
     }
@@ -37,9 +37,157 @@
 
 #include "parser.h"
 
+/**
+ * P1Reader reads bytes from the Stream in chunks of this size (using
+ * available() and readBytes()), and then processes each chunk at once,
+ * instead of calling read() for every single byte. The chunk is part of
+ * the P1Reader object, so this costs RAM. Defaults to 0 (read
+ * byte-by-byte) on AVR, where RAM is scarce and reading from
+ * HardwareSerial is cheap anyway.
+ */
+#ifndef DSMR_READER_CHUNK_SIZE
+#ifdef __AVR__
+#define DSMR_READER_CHUNK_SIZE 0
+#else
+#define DSMR_READER_CHUNK_SIZE 64
+#endif
+#endif
+
+static_assert(DSMR_READER_CHUNK_SIZE < 256, "DSMR_READER_CHUNK_SIZE must fit in an uint8_t");
+
+/**
+ * When set to 1, P1Reader keeps counters of what it reads and throws
+ * away, see P1ReaderStats and P1Reader::stats(). This costs a few
+ * instructions per chunk and 32 bytes of RAM, so it defaults to 0, in
+ * which case the counters are compiled out completely.
+ */
+#ifndef DSMR_READER_STATS
+#define DSMR_READER_STATS 0
+#endif
+
+/**
+ * When set to 1, P1Reader records micros() at each stage of receiving
+ * and parsing a message and keeps a histogram of the time spent in each
+ * stage, see P1ReaderTiming and P1Reader::timing(). Defaults to 0, in
+ * which case none of this is compiled in.
+ */
+#ifndef DSMR_READER_TIMING
+#define DSMR_READER_TIMING 0
+#endif
+
 namespace dsmr
 {
 
+#if DSMR_READER_STATS
+  /**
+   * Counters kept by P1Reader when DSMR_READER_STATS is enabled. These
+   * help to tell noise on the line (many discarded bytes and checksum
+   * errors) apart from a consumer that is too slow (dropped messages).
+   * All counters wrap around on overflow.
+   */
+  struct P1ReaderStats
+  {
+    // Bytes read from the stream, including the checksum
+    uint32_t bytes_read;
+    // Bytes read while waiting for the start of a message or while
+    // disabled, which are thrown away
+    uint32_t bytes_discarded;
+    // Messages received completely with a correct checksum
+    uint32_t telegrams;
+    // Messages whose checksum did not match their contents
+    uint32_t crc_mismatches;
+    // Messages whose checksum could not be parsed
+    uint32_t malformed_checksums;
+    // Messages for which parse() failed
+    uint32_t parse_failures;
+    // Length of the longest message seen, excluding the leading / and
+    // everything from the ! onwards (i.e. as returned by raw())
+    uint32_t max_length;
+    // micros() when the last message with a correct checksum was
+    // complete
+    uint32_t last_good_micros;
+  };
+#endif
+
+#if DSMR_READER_TIMING
+  /**
+   * Histogram of durations in microseconds, with buckets that double in
+   * size: bucket 0 counts durations below 64us, bucket i below 64us << i
+   * and the last bucket everything longer (above a second). Counts
+   * saturate instead of wrapping around.
+   */
+  struct LatencyHistogram
+  {
+    static const uint8_t BUCKETS = 16;
+    static const uint32_t FIRST_LIMIT = 64;
+
+    uint16_t counts[BUCKETS];
+    // The longest duration added
+    uint32_t max;
+
+    void add(uint32_t us)
+    {
+      uint8_t b = bucket(us);
+      if (this->counts[b] != 0xffff)
+        this->counts[b]++;
+      if (us > this->max)
+        this->max = us;
+    }
+
+    /**
+     * Returns the bucket a duration is counted in.
+     */
+    static uint8_t bucket(uint32_t us)
+    {
+      uint8_t b = 0;
+      for (us /= FIRST_LIMIT; us && b < BUCKETS - 1; us >>= 1)
+        ++b;
+      return b;
+    }
+
+    /**
+     * Returns the (exclusive) upper limit of a bucket, or 0 for the last
+     * bucket, which has no limit.
+     */
+    static uint32_t limit(uint8_t bucket)
+    {
+      return bucket < BUCKETS - 1 ? FIRST_LIMIT << bucket : 0;
+    }
+  };
+
+  /**
+   * Timestamps and durations kept by P1Reader when DSMR_READER_TIMING is
+   * enabled. The timestamps are micros() values of the most recent
+   * message. Note that with DSMR_READER_CHUNK_SIZE, bytes are seen when
+   * their chunk is processed by loop(), so the start and end timestamps
+   * can be later than when the bytes actually arrived (by at most the
+   * interval between loop() calls).
+   */
+  struct P1ReaderTiming
+  {
+    // The / that starts a message was seen
+    uint32_t start;
+    // The ! that ends a message was seen
+    uint32_t end;
+    // The checksum was received and verified correct
+    uint32_t verified;
+    // parse() was called
+    uint32_t parse_start;
+    // parse() was finished
+    uint32_t parsed;
+
+    // From start to end, i.e. receiving the message
+    LatencyHistogram receive;
+    // From end to verified, i.e. receiving and checking the checksum
+    LatencyHistogram checksum;
+    // From parse_start to parsed, i.e. parsing the fields
+    LatencyHistogram parse;
+    // From the start of a message to the end of parsing it, including
+    // any time the message waited for parse() to be called
+    LatencyHistogram total;
+  };
+#endif
+
   /**
  * Controls the request pin on the P1 port to enable (periodic)
  * transmission of messages and reads those messages.
@@ -60,9 +208,22 @@ namespace dsmr
  * When disable is called, the request pin is disabled again and any
  * partial message is discarded. Any bytes received while disabled are
  * dropped.
+ *
+ * The reader has num_slots message buffers. With a single buffer (as
+ * in P1Reader), a complete message that was not parsed or cleared yet
+ * is dropped once the next message starts. With more buffers, complete
+ * messages are queued and the next message is received into a free
+ * buffer, so a consumer can take up to a full message interval to
+ * process a message without losing the next one. available(), raw()
+ * and parse() then operate on the oldest queued message. When all
+ * buffers are full as a new message starts, the oldest message is
+ * dropped, which is counted by dropped().
  */
-  class P1Reader
+  template <uint8_t num_slots>
+  class BasicP1Reader
   {
+    static_assert(num_slots > 0, "BasicP1Reader needs at least one slot");
+
   public:
     /**
      * Create a new P1Reader. The stream passed should be the serial
@@ -71,9 +232,19 @@ namespace dsmr
      * output, the Stream is assumed to be already set up (e.g. baud
      * rate configured).
      */
-    P1Reader(Stream *stream, uint8_t req_pin)
-        : stream(stream), req_pin(req_pin), once(false), state(State::DISABLED_STATE)
+    BasicP1Reader(Stream *stream, uint8_t req_pin)
+        : stream(stream), req_pin(req_pin), once(false), state(State::DISABLED_STATE), head(0), count(0), dropped_count(0),
+          error(ParseError::NONE)
     {
+      this->chunk_pos = this->chunk_len = 0;
+      this->cursor.pos = NULL;
+      this->step_dropped = false;
+#if DSMR_READER_STATS
+      this->reset_stats();
+#endif
+#if DSMR_READER_TIMING
+      this->reset_timing();
+#endif
       pinMode(req_pin, OUTPUT);
       digitalWrite(req_pin, LOW);
     }
@@ -102,11 +273,20 @@ namespace dsmr
     {
       digitalWrite(this->req_pin, LOW);
       this->state = State::DISABLED_STATE;
-      if (!this->_available)
-        this->buffer = "";
+      if (this->count < num_slots)
+        this->receiving() = "";
       // Clear any pending bytes
-      while (this->stream->read() >= 0) /* nothing */
-        ;
+#if DSMR_READER_STATS
+      this->statistics.bytes_discarded += this->buffered();
+#endif
+      this->chunk_pos = this->chunk_len = 0;
+      while (this->stream->read() >= 0)
+      {
+#if DSMR_READER_STATS
+        this->statistics.bytes_read++;
+        this->statistics.bytes_discarded++;
+#endif
+      }
     }
 
     /**
@@ -115,8 +295,58 @@ namespace dsmr
      */
     bool available()
     {
-      return this->_available;
+      return this->count > 0;
+    }
+
+    /**
+     * Returns the number of complete messages that were dropped because
+     * all buffers were full when the next message started.
+     */
+    uint32_t dropped()
+    {
+      return this->dropped_count;
+    }
+
+#if DSMR_READER_STATS
+    /**
+     * Returns the counters kept since the reader was created or
+     * reset_stats() was called. Only available when DSMR_READER_STATS
+     * is enabled.
+     */
+    const P1ReaderStats &stats() const
+    {
+      return this->statistics;
+    }
+
+    /**
+     * Reset all counters returned by stats() to zero.
+     */
+    void reset_stats()
+    {
+      memset(&this->statistics, 0, sizeof(this->statistics));
+    }
+#endif
+
+#if DSMR_READER_TIMING
+    /**
+     * Returns the timestamps of the most recent message and the
+     * histograms of the time spent in each stage since the reader was
+     * created or reset_timing() was called. Only available when
+     * DSMR_READER_TIMING is enabled.
+     */
+    const P1ReaderTiming &timing() const
+    {
+      return this->timings;
+    }
+
+    /**
+     * Clear all timestamps and histograms returned by timing().
+     */
+    void reset_timing()
+    {
+      memset(&this->timings, 0, sizeof(this->timings));
     }
+#endif
 
     /**
      * Check for new data to read. Should be called regularly, such as
@@ -125,20 +355,58 @@ namespace dsmr
      */
     bool loop()
     {
-      while (true)
+      return this->loop_budget((size_t)-1, 0);
+    }
+
+    /**
+     * Like loop(), but returns after processing max_bytes bytes, even
+     * when more bytes are available, so other work can be done in
+     * between (e.g. to keep the WiFi stack of an ESP8266 running). The
+     * checksum is always read at once, so up to CrcParser::CRC_LEN - 1
+     * bytes more can be processed.
+     */
+    bool loop_bytes(size_t max_bytes)
+    {
+      return this->loop_budget(max_bytes, 0);
+    }
+
+    /**
+     * Like loop(), but returns once max_us microseconds have passed,
+     * even when more bytes are available. The time is checked after
+     * each chunk (see DSMR_READER_CHUNK_SIZE) or byte, so this can take
+     * a little longer than max_us.
+     */
+    bool loop_micros(uint32_t max_us)
+    {
+      return this->loop_budget((size_t)-1, max_us ? max_us : 1);
+    }
+
+    /**
+     * Same as loop(), but returns after processing max_bytes bytes or
+     * when max_us microseconds have passed, whichever comes first. A
+     * max_us of 0 means there is no time limit.
+     */
+    bool loop_budget(size_t max_bytes, uint32_t max_us)
+    {
+      uint32_t start = max_us ? micros() : 0;
+      while (max_bytes)
       {
+        if (max_us && (uint32_t)(micros() - start) >= max_us)
+          return false;
+
         if (state == State::CHECKSUM_STATE)
         {
           // Let the Stream buffer the CRC bytes. Convert to size_t to
           // prevent unsigned vs signed comparison
-          if ((size_t)this->stream->available() < CrcParser::CRC_LEN)
+          if (this->buffered() + (size_t)this->stream->available() < CrcParser::CRC_LEN)
             return false;
 
           char buf[CrcParser::CRC_LEN];
           for (uint8_t i = 0; i < CrcParser::CRC_LEN; ++i)
-            buf[i] = this->stream->read();
+            buf[i] = this->read_byte();
 
           ParseResult<uint16_t> crc = CrcParser::parse(buf, buf + lengthof(buf));
+          max_bytes = max_bytes > CrcParser::CRC_LEN ? max_bytes - CrcParser::CRC_LEN : 0;
 
           // Prepare for next message
           state = State::WAITING_STATE;
@@ -146,51 +414,50 @@ namespace dsmr
           if (!crc.err && crc.result == this->crc)
           {
             // Message complete, checksum correct
-            this->_available = true;
+            this->count++;
+#if DSMR_READER_STATS
+            this->statistics.telegrams++;
+            this->statistics.last_good_micros = micros();
+#endif
+#if DSMR_READER_TIMING
+            this->timings.verified = micros();
+            this->timings.checksum.add(this->timings.verified - this->timings.end);
+#endif
 
             if (once)
               this->disable();
 
             return true;
           }
+#if DSMR_READER_STATS
+          if (crc.err)
+            this->statistics.malformed_checksums++;
+          else
+            this->statistics.crc_mismatches++;
+#endif
         }
         else
         {
-          // For other states, read bytes one by one
-          int c = this->stream->read();
-          if (c < 0)
-            return false;
-
-          switch (this->state)
+          if (!this->buffered() && !this->fill_chunk())
           {
-          case State::DISABLED_STATE:
-            // Where did this byte come from? Just toss it
-            break;
-          case State::WAITING_STATE:
-            if (c == '/')
-            {
-              this->state = State::READING_STATE;
-              // Include the / in the CRC
-              this->crc = _crc16_update(0, c);
-              this->clear();
-            }
-            break;
-          case State::READING_STATE:
-            // Include the ! in the CRC
-            this->crc = _crc16_update(this->crc, c);
-            if (c == '!')
-              this->state = State::CHECKSUM_STATE;
-            else
-              buffer.concat((char)c);
-
-            break;
-          case State::CHECKSUM_STATE:
-            // This cannot happen (given the surrounding if), but the
-            // compiler is not smart enough to see this, so list this
-            // case to prevent a warning.
-            abort();
-            break;
+            // Read bytes one by one
+            int c = this->stream->read();
+            if (c < 0)
+              return false;
+
+            this->chunk[0] = c;
+            this->chunk_pos = 0;
+            this->chunk_len = 1;
+#if DSMR_READER_STATS
+            this->statistics.bytes_read++;
+#endif
           }
+
+          // Process as much of the chunk as possible at once
+          size_t n = this->buffered() < max_bytes ? this->buffered() : max_bytes;
+          n = this->process(this->chunk + this->chunk_pos, n);
+          this->chunk_pos += n;
+          max_bytes -= n;
         }
       }
       return false;
@@ -201,7 +468,7 @@ namespace dsmr
      */
     const String &raw()
     {
-      return buffer;
+      return this->buffers[this->head];
     }
 
     /**
@@ -211,33 +478,111 @@ namespace dsmr
      * After parsing, the message is cleared.
      *
      * If parsing fails, false is returned. If err is passed, the error
-     * message is appended to that string.
+     * message is appended to that string. last_error() returns the
+     * error code.
+     *
+     * With DSMR_STRING_VIEW, the parsed string values point into the
+     * message buffer, so it is not cleared yet: the values stay valid
+     * until a new message is received into the same buffer (with a single
+     * buffer: when the next message starts) or disable() is called.
      */
     template <typename... Ts>
     bool parse(ParsedData<Ts...> *data, String *err)
     {
+#if DSMR_READER_TIMING
+      this->timings.parse_start = micros();
+#endif
+      const String &buffer = this->buffers[this->head];
       const char *str = buffer.c_str(), *end = buffer.c_str() + buffer.length();
       ParseResult<void> res = P1Parser::parse_data(data, str, end);
 
       if (res.err && err)
         *err = res.fullError(str, end);
 
-      // Clear the message
-      this->clear();
+      return this->parsed(res);
+    }
 
-      return res.err == NULL;
+    /**
+     * Same as above, but prints the error message (if any) to err, so no
+     * String is allocated for it.
+     */
+    template <typename... Ts>
+    bool parse(ParsedData<Ts...> *data, Print &err)
+    {
+#if DSMR_READER_TIMING
+      this->timings.parse_start = micros();
+#endif
+      const String &buffer = this->buffers[this->head];
+      const char *str = buffer.c_str(), *end = buffer.c_str() + buffer.length();
+      ParseResult<void> res = P1Parser::parse_data(data, str, end);
+
+      if (res.err)
+        res.printFullError(err, str, end);
+
+      return this->parsed(res);
     }
 
     /**
-     * Clear any complete message from the buffer.
+     * Parse the oldest complete message a few lines at a time, so that a
+     * large message does not keep the processor busy for too long (see
+     * also loop_bytes()). Each call parses at most max_lines (non-empty)
+     * lines into data. Returns false when there are more lines to parse:
+     * call this again later with the same data object to continue.
+     * Returns true when the message is done, after which the message is
+     * cleared like parse() does, and last_error() tells whether parsing
+     * succeeded. If err is passed, the error message is appended to
+     * that string.
+     *
+     * When the message is dropped halfway (because a new message started
+     * and there was no free buffer), or there is no complete message at
+     * all, this returns true with ParseError::NO_MESSAGE. The lines
+     * parsed so far are left in data.
      */
-    void clear()
+    template <typename... Ts>
+    bool parse_step(ParsedData<Ts...> *data, size_t max_lines, String *err = NULL)
     {
-      if (_available)
+      if (!this->count || this->step_dropped)
+      {
+        this->step_dropped = false;
+        this->error = ParseError::NO_MESSAGE;
+        if (err)
+          *err = parse_error_message(this->error);
+        return true;
+      }
+
+      const String &buffer = this->buffers[this->head];
+      const char *str = buffer.c_str(), *end = buffer.c_str() + buffer.length();
+      if (!this->cursor.pos)
       {
-        buffer = "";
-        _available = false;
+#if DSMR_READER_TIMING
+        this->timings.parse_start = micros();
+#endif
+        this->cursor.start(str, end);
       }
+
+      ParseResult<void> res = P1Parser::parse_data_step(data, &this->cursor, max_lines);
+      if (!res.err && !this->cursor.done())
+        return false;
+
+      if (res.err && err)
+        *err = res.fullError(str, end);
+
+      this->parsed(res);
+      return true;
+    }
+
+    /**
+     * Returns the error code of the last message parsed, or
+     * ParseError::NONE if it was parsed succesfully.
+     */
+    ParseError last_error() const { return this->error; }
+
+    /**
+     * Clear the (oldest) complete message from the buffer, if any.
+     */
+    void clear()
+    {
+      this->pop(true);
     }
 
   protected:
@@ -250,11 +595,207 @@ namespace dsmr
       READING_STATE,
       CHECKSUM_STATE,
     };
-    bool _available;
     bool once;
     State state;
-    String buffer;
+    // Ring of message buffers: count complete messages starting at head,
+    // followed by the buffer that is being received into.
+    String buffers[num_slots];
+    uint8_t head;
+    uint8_t count;
+    uint32_t dropped_count;
+    ParseError error;
     uint16_t crc;
+    // Progress of parse_step() in the oldest message, pos is NULL when
+    // it was not started yet
+    DataCursor cursor;
+    // The message parse_step() was working on was dropped
+    bool step_dropped;
+#if DSMR_READER_STATS
+    P1ReaderStats statistics;
+#endif
+#if DSMR_READER_TIMING
+    P1ReaderTiming timings;
+    // When each message in buffers started
+    uint32_t started[num_slots];
+#endif
+
+    // Bytes read from the stream, but not processed yet
+    char chunk[DSMR_READER_CHUNK_SIZE > 0 ? DSMR_READER_CHUNK_SIZE : 1];
+    uint8_t chunk_pos;
+    uint8_t chunk_len;
+
+    // Process bytes received in the WAITING_STATE, READING_STATE or
+    // DISABLED_STATE, until the end of the buffer or until the state
+    // changes. Returns the number of bytes processed.
+    size_t process(const char *buf, size_t len)
+    {
+      const char *end = buf + len;
+      switch (this->state)
+      {
+      case State::DISABLED_STATE:
+        // Where did these bytes come from? Just toss them
+#if DSMR_READER_STATS
+        this->statistics.bytes_discarded += len;
+#endif
+        return len;
+      case State::WAITING_STATE:
+      {
+        const char *p = static_cast<const char *>(memchr(buf, '/', len));
+#if DSMR_READER_STATS
+        this->statistics.bytes_discarded += (p ? p : end) - buf;
+#endif
+        if (!p)
+          return len;
+
+        this->state = State::READING_STATE;
+        // Include the / in the CRC
+        this->crc = _crc16_update(0, '/');
+        if (this->count == num_slots)
+        {
+          // No free buffer, drop the oldest message
+          if (this->cursor.pos)
+            this->step_dropped = true;
+          this->pop(true);
+          this->dropped_count++;
+        }
+        // A parsed message may have been kept, see parse()
+        this->receiving() = "";
+#if DSMR_READER_TIMING
+        this->timings.start = micros();
+        this->started[(this->head + this->count) % num_slots] = this->timings.start;
+#endif
+        return p + 1 - buf;
+      }
+      case State::READING_STATE:
+      {
+        const char *p = static_cast<const char *>(memchr(buf, '!', len));
+        if (!p)
+          p = end;
+
+        this->crc = crc16_update(this->crc, buf, p - buf);
+        if (p - buf == 1)
+          this->receiving().concat(*buf);
+        else if (p != buf)
+          concat_hack(this->receiving(), buf, p - buf);
+
+        if (p == end)
+          return len;
+
+#if DSMR_READER_STATS
+        if (this->receiving().length() > this->statistics.max_length)
+          this->statistics.max_length = this->receiving().length();
+#endif
+#if DSMR_READER_TIMING
+        this->timings.end = micros();
+        this->timings.receive.add(this->timings.end - this->timings.start);
+#endif
+
+        // Include the ! in the CRC
+        this->crc = _crc16_update(this->crc, '!');
+        this->state = State::CHECKSUM_STATE;
+        return p + 1 - buf;
+      }
+      case State::CHECKSUM_STATE:
+        // This cannot happen (the CRC is read by loop() directly), but
+        // the compiler is not smart enough to see this, so list this
+        // case to prevent a warning.
+        abort();
+        break;
+      }
+      return len;
+    }
+
+    // Returns the number of bytes read from the stream, but not
+    // processed yet.
+    size_t buffered()
+    {
+      return this->chunk_len - this->chunk_pos;
+    }
+
+    // Read a single byte, from the chunk if there are unprocessed bytes
+    // there, or from the stream otherwise.
+    int read_byte()
+    {
+      if (this->chunk_pos < this->chunk_len)
+        return (uint8_t)this->chunk[this->chunk_pos++];
+#if DSMR_READER_STATS
+      this->statistics.bytes_read++;
+#endif
+      return this->stream->read();
+    }
+
+    // Read as many bytes as are available from the stream into the
+    // chunk (if that is more than one, otherwise the byte path is just
+    // as fast). Returns true when bytes were read.
+    bool fill_chunk()
+    {
+      if (DSMR_READER_CHUNK_SIZE == 0)
+        return false;
+
+      int avail = this->stream->available();
+      if (avail <= 1)
+        return false;
+
+      size_t n = (size_t)avail < sizeof(this->chunk) ? (size_t)avail : sizeof(this->chunk);
+      // These bytes are available, so this does not wait for the timeout
+      this->chunk_len = this->stream->readBytes(this->chunk, n);
+      this->chunk_pos = 0;
+#if DSMR_READER_STATS
+      this->statistics.bytes_read += this->chunk_len;
+#endif
+      return this->chunk_len > 0;
+    }
+
+    String &receiving()
+    {
+      return this->buffers[(this->head + this->count) % num_slots];
+    }
+
+    // Finish parsing the oldest message with the given result
+    bool parsed(const ParseResult<void> &res)
+    {
+      this->error = res.code;
+#if DSMR_READER_STATS
+      if (res.err)
+        this->statistics.parse_failures++;
+#endif
+#if DSMR_READER_TIMING
+      if (this->count)
+      {
+        this->timings.parsed = micros();
+        this->timings.parse.add(this->timings.parsed - this->timings.parse_start);
+        this->timings.total.add(this->timings.parsed - this->started[this->head]);
+      }
+#endif
+
+      // Clear the message
+      this->pop(DSMR_STRING_STORAGE != DSMR_STRING_VIEW);
+
+      return res.err == NULL;
+    }
+
+    // Remove the oldest complete message, if any. When erase is false,
+    // its contents are kept until the buffer is reused.
+    void pop(bool erase)
+    {
+      if (!this->count)
+        return;
+      this->cursor.pos = NULL;
+      if (erase)
+        this->buffers[this->head] = "";
+      this->head = (this->head + 1) % num_slots;
+      this->count--;
+    }
+  };
+
+  /**
+ * P1Reader with a single message buffer. This is a class rather than a
+ * typedef, so it can still be forward declared as class P1Reader.
+ */
+  class P1Reader : public BasicP1Reader<1>
+  {
+  public:
+    P1Reader(Stream *stream, uint8_t req_pin) : BasicP1Reader<1>(stream, req_pin) {}
   };
 
 } // namespace dsmr
@@ -0,0 +1,206 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Lock-free single-producer / single-consumer byte ring, to pass bytes
+ * from a UART interrupt or a receiving thread (or core) to a P1Reader.
+ * This needs std::atomic, so it is not available on AVR and is not
+ * included by dsmr.h.
+ */
+
+#ifndef DSMR_INCLUDE_RING_H
+#define DSMR_INCLUDE_RING_H
+
+#include <Arduino.h>
+#include <string.h>
+
+#include <atomic>
+
+namespace dsmr
+{
+
+  /**
+   * A ring buffer of N bytes (which must be a power of two) that one
+   * producer writes into and one consumer reads from, each from its own
+   * thread, core or interrupt, without locks.
+   *
+   * The producer calls push() (or write(), as this is a Print), which
+   * never waits: bytes that do not fit are dropped and counted by
+   * overflows(). The consumer reads the bytes using drain(), or passes
+   * the ring as the Stream of a P1Reader. readBytes() does not wait for
+   * more bytes either, so P1Reader reads everything that is available
+   * in chunks.
+   *
+   * No other methods may be called concurrently, e.g. two producers
+   * need a lock around push(). When push() is called from an interrupt
+   * on ESP32, make sure the ISR and the ring are in IRAM.
+   */
+  template <size_t N>
+  class SpscRing : public Stream
+  {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+  public:
+    SpscRing() : head(0), overflow_count(0), tail(0) {}
+
+    /**
+     * Add the bytes in buf to the ring. Returns the number of bytes
+     * added, bytes that did not fit are dropped. Producer only.
+     */
+    size_t push(const uint8_t *buf, size_t len)
+    {
+      size_t h = this->head.load(std::memory_order_relaxed);
+      size_t free = N - (h - this->tail.load(std::memory_order_acquire));
+      if (len > free)
+      {
+        this->overflow_count.fetch_add(len - free, std::memory_order_relaxed);
+        len = free;
+      }
+      copy_in(h, buf, len);
+      this->head.store(h + len, std::memory_order_release);
+      return len;
+    }
+
+    /**
+     * Add a single byte. Returns false when the ring was full and the
+     * byte was dropped. Producer only.
+     */
+    bool push(uint8_t c)
+    {
+      size_t h = this->head.load(std::memory_order_relaxed);
+      if (h - this->tail.load(std::memory_order_acquire) == N)
+      {
+        this->overflow_count.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      this->buf[h & (N - 1)] = c;
+      this->head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Returns the number of bytes that can be pushed without dropping
+     * any. Producer only.
+     */
+    size_t room() const
+    {
+      return N - (this->head.load(std::memory_order_relaxed) - this->tail.load(std::memory_order_acquire));
+    }
+
+    size_t write(uint8_t c) override { return this->push(c); }
+    size_t write(const uint8_t *buffer, size_t size) override { return this->push(buffer, size); }
+    using Print::write;
+
+    /**
+     * Move up to len bytes out of the ring into buf. Returns the number
+     * of bytes moved. Consumer only.
+     */
+    size_t drain(char *buf, size_t len)
+    {
+      size_t t = this->tail.load(std::memory_order_relaxed);
+      size_t used = this->head.load(std::memory_order_acquire) - t;
+      if (len > used)
+        len = used;
+      copy_out(t, buf, len);
+      this->tail.store(t + len, std::memory_order_release);
+      return len;
+    }
+
+    int available() override
+    {
+      return this->head.load(std::memory_order_acquire) - this->tail.load(std::memory_order_relaxed);
+    }
+
+    int read() override
+    {
+      size_t t = this->tail.load(std::memory_order_relaxed);
+      if (this->head.load(std::memory_order_acquire) == t)
+        return -1;
+      uint8_t c = this->buf[t & (N - 1)];
+      this->tail.store(t + 1, std::memory_order_release);
+      return c;
+    }
+
+    int peek() override
+    {
+      size_t t = this->tail.load(std::memory_order_relaxed);
+      if (this->head.load(std::memory_order_acquire) == t)
+        return -1;
+      return this->buf[t & (N - 1)];
+    }
+
+    size_t readBytes(char *buffer, size_t size) override { return this->drain(buffer, size); }
+
+    /**
+     * Returns the number of bytes dropped because the ring was full.
+     * Can be called from either side.
+     */
+    uint32_t overflows() const
+    {
+      return this->overflow_count.load(std::memory_order_relaxed);
+    }
+
+  protected:
+    // Both positions run freely and wrap around modulo SIZE_MAX + 1,
+    // which is a multiple of N, so head - tail is always the number of
+    // bytes used. The head and overflow_count are only written by the
+    // producer and the tail only by the consumer, so they are on
+    // separate cache lines, to prevent the two sides from invalidating
+    // each other's cache line on every byte. This uses padding of a
+    // full cache line rather than alignas, since over-aligned types are
+    // not allocated correctly by new before C++17 (and the ring is
+    // usually too big for the stack anyway).
+    static const size_t CACHE_LINE = 64;
+    std::atomic<size_t> head;
+    std::atomic<uint32_t> overflow_count;
+    char head_pad[CACHE_LINE];
+    uint8_t buf[N];
+    char tail_pad[CACHE_LINE];
+    std::atomic<size_t> tail;
+    char end_pad[CACHE_LINE];
+
+    // Copy len bytes into the ring, starting at position pos, in at most
+    // two parts when the ring wraps
+    void copy_in(size_t pos, const uint8_t *src, size_t len)
+    {
+      size_t start = pos & (N - 1);
+      size_t first = len < N - start ? len : N - start;
+      memcpy(this->buf + start, src, first);
+      memcpy(this->buf, src + first, len - first);
+    }
+
+    void copy_out(size_t pos, char *dst, size_t len)
+    {
+      size_t start = pos & (N - 1);
+      size_t first = len < N - start ? len : N - start;
+      memcpy(dst, this->buf + start, first);
+      memcpy(dst + first, this->buf, len - first);
+    }
+  };
+
+} // namespace dsmr
+
+#endif // DSMR_INCLUDE_RING_H
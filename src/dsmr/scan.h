@@ -0,0 +1,263 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Scanner that finds the line terminators and the ! that ends the data
+ * in a P1 message, using SIMD instructions where available.
+ */
+
+#ifndef DSMR_INCLUDE_SCAN_H
+#define DSMR_INCLUDE_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crc16.h"
+
+/**
+ * Number of line terminators a LineIndex can hold. Each CRLF counts
+ * twice, so this is twice the number of lines that are indexed in one
+ * go. P1Parser scans the data part of a message into such an index
+ * (on the stack) before parsing the lines. If a message has more
+ * lines, it just scans the rest after parsing the first lines. When 0,
+ * no index is used and P1Parser splits lines byte by byte.
+ *
+ * The index takes 2 bytes per terminator plus a few pointers of stack,
+ * so about 270 bytes with the default of 128 on a 32-bit target. That
+ * is a lot for the small stacks on AVR and ESP8266 (4k for the loop
+ * task), so there the index is disabled by default.
+ */
+#ifndef DSMR_LINE_INDEX_SIZE
+#if defined(__AVR__) || defined(ARDUINO_ARCH_ESP8266)
+#define DSMR_LINE_INDEX_SIZE 0
+#else
+#define DSMR_LINE_INDEX_SIZE 128
+#endif
+#endif
+
+/**
+ * scan_lines() processes 32 (AVX2) or 16 (SSE2, NEON) bytes at a time,
+ * with a bytewise loop for the remainder. DSMR_SCAN_SCALAR only uses
+ * the bytewise loop. Define DSMR_SCAN_IMPL to one of these to override
+ * the choice based on the instruction sets enabled for the compiler.
+ */
+#define DSMR_SCAN_SCALAR 0
+#define DSMR_SCAN_SSE2 1
+#define DSMR_SCAN_AVX2 2
+#define DSMR_SCAN_NEON 3
+
+#ifndef DSMR_SCAN_IMPL
+#if defined(__AVX2__)
+#define DSMR_SCAN_IMPL DSMR_SCAN_AVX2
+#elif defined(__SSE2__)
+#define DSMR_SCAN_IMPL DSMR_SCAN_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define DSMR_SCAN_IMPL DSMR_SCAN_NEON
+#else
+#define DSMR_SCAN_IMPL DSMR_SCAN_SCALAR
+#endif
+#endif
+
+#if DSMR_SCAN_IMPL == DSMR_SCAN_AVX2
+#include <immintrin.h>
+#elif DSMR_SCAN_IMPL == DSMR_SCAN_SSE2
+#include <emmintrin.h>
+#elif DSMR_SCAN_IMPL == DSMR_SCAN_NEON
+#include <arm_neon.h>
+#endif
+
+#if DSMR_LINE_INDEX_SIZE > 0
+
+namespace dsmr
+{
+
+  /**
+   * Positions of the line terminators (\r or \n) found by scan_lines().
+   */
+  struct LineIndex
+  {
+    static const size_t CAPACITY = DSMR_LINE_INDEX_SIZE;
+
+    // Start of the scanned data, ends are relative to this
+    const char *base;
+    // Where scanning stopped: at the !, at the end of the data, or at
+    // the first byte not scanned yet when the index is full
+    const char *stop;
+    uint16_t count;
+    bool full;
+    uint16_t ends[CAPACITY];
+
+    // Returns the position of the i-th line terminator
+    const char *end(size_t i) const
+    {
+      return this->base + this->ends[i];
+    }
+  };
+
+#if DSMR_SCAN_IMPL == DSMR_SCAN_AVX2
+  typedef uint32_t _scan_mask_t;
+  static const size_t _SCAN_WIDTH = 32;
+  static const unsigned _SCAN_BITS_PER_BYTE = 1;
+
+  // Returns a mask with a bit set for each \r, \n or ! in the block at p
+  inline _scan_mask_t _scan_mask(const char *p)
+  {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')),
+                                                 _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('!')));
+    return (uint32_t)_mm256_movemask_epi8(m);
+  }
+#elif DSMR_SCAN_IMPL == DSMR_SCAN_SSE2
+  typedef uint32_t _scan_mask_t;
+  static const size_t _SCAN_WIDTH = 16;
+  static const unsigned _SCAN_BITS_PER_BYTE = 1;
+
+  inline _scan_mask_t _scan_mask(const char *p)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                                          _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('!')));
+    return (uint32_t)_mm_movemask_epi8(m);
+  }
+#elif DSMR_SCAN_IMPL == DSMR_SCAN_NEON
+  typedef uint64_t _scan_mask_t;
+  static const size_t _SCAN_WIDTH = 16;
+  static const unsigned _SCAN_BITS_PER_BYTE = 4;
+
+  inline _scan_mask_t _scan_mask(const char *p)
+  {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+    uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('\r')), vceqq_u8(v, vdupq_n_u8('\n'))),
+                            vceqq_u8(v, vdupq_n_u8('!')));
+    // NEON has no movemask, so narrow each byte to a nibble and keep
+    // one bit of each nibble
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ULL;
+  }
+#endif
+
+  // Scan p up to end for line terminators, recording each in index
+  // (relative to index->base), until a ! is found or the index is full.
+  // Returns the position of the ! or the terminator that did not fit, or
+  // end. Vector loads are only done for whole blocks before end, the rest
+  // is done bytewise, so nothing at or after end is read.
+  inline const char *_scan_block(const char *p, const char *end, LineIndex *index)
+  {
+#if DSMR_SCAN_IMPL != DSMR_SCAN_SCALAR
+    for (; (size_t)(end - p) >= _SCAN_WIDTH; p += _SCAN_WIDTH)
+    {
+      _scan_mask_t mask = _scan_mask(p);
+      while (mask)
+      {
+        const char *c = p + __builtin_ctzll(mask) / _SCAN_BITS_PER_BYTE;
+        if (*c == '!')
+          return c;
+        if (index->count == LineIndex::CAPACITY)
+        {
+          index->full = true;
+          return c;
+        }
+        index->ends[index->count++] = c - index->base;
+        mask &= mask - 1;
+      }
+    }
+#endif
+    for (; p < end; ++p)
+    {
+      if (*p == '!')
+        break;
+      if (*p == '\r' || *p == '\n')
+      {
+        if (index->count == LineIndex::CAPACITY)
+        {
+          index->full = true;
+          break;
+        }
+        index->ends[index->count++] = p - index->base;
+      }
+    }
+    return p;
+  }
+
+  // Prepare index for scanning str, returns where scanning must end
+  inline const char *_scan_start(const char *str, const char *end, LineIndex *index)
+  {
+    index->base = str;
+    index->count = 0;
+    index->full = false;
+    // Offsets must fit in the index, scan longer data in parts
+    return end - str > 0xffff ? str + 0xffff : end;
+  }
+
+  /**
+   * Scan str up to end for line terminators (\r or \n), recording each
+   * in index, until a ! is found. Scanning also stops when the index is
+   * full, after the last terminator recorded (or after 64 kiB, where the
+   * offsets would overflow). Returns index->stop, which
+   * is the position of the !, end if there is no !, or the first byte
+   * that was not scanned when index->full is set.
+   */
+  inline const char *scan_lines(const char *str, const char *end, LineIndex *index)
+  {
+    const char *scan_end = _scan_start(str, end, index);
+    const char *p = _scan_block(str, scan_end, index);
+    if (p == scan_end && scan_end != end)
+      index->full = true;
+    return index->stop = p;
+  }
+
+  /**
+   * Like scan_lines, but also updates crc with all scanned bytes (so up
+   * to, but not including index->stop). The data is processed in small
+   * blocks that are checksummed right after scanning them, while they
+   * are still in the cache, so this makes a single pass over memory.
+   */
+  inline const char *scan_lines(const char *str, const char *end, LineIndex *index, uint16_t *crc)
+  {
+    const size_t BLOCK_SIZE = 256;
+    const char *scan_end = _scan_start(str, end, index);
+    const char *p = str;
+    while (p < scan_end)
+    {
+      size_t n = (size_t)(scan_end - p) > BLOCK_SIZE ? BLOCK_SIZE : scan_end - p;
+      const char *stop = _scan_block(p, p + n, index);
+      *crc = crc16_update(*crc, p, stop - p);
+      if (stop != p + n)
+        return index->stop = stop;
+      p = stop;
+    }
+    if (scan_end != end)
+      index->full = true;
+    return index->stop = p;
+  }
+
+} // namespace dsmr
+
+#endif // DSMR_LINE_INDEX_SIZE > 0
+
+#endif // DSMR_INCLUDE_SCAN_H
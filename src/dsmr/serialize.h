@@ -0,0 +1,655 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Compact binary encoding of ParsedData, for storing parsed telegrams
+ * or sending them on (e.g. instead of JSON).
+ */
+
+#ifndef DSMR_INCLUDE_SERIALIZE_H
+#define DSMR_INCLUDE_SERIALIZE_H
+
+#include "fields.h"
+#include "parser.h"
+#include "util.h"
+
+namespace dsmr
+{
+
+  /**
+   * Appends bytes to a buffer. When the buffer is full, further bytes
+   * are dropped, but still counted in len, so len is always the size
+   * needed to write everything.
+   */
+  struct BinaryWriter
+  {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+
+    BinaryWriter(uint8_t *buf, size_t size) : buf(buf), size(size), len(0) {}
+
+    void put(uint8_t b)
+    {
+      if (this->len < this->size)
+        this->buf[this->len] = b;
+      this->len++;
+    }
+
+    void put_bytes(const char *str, size_t n)
+    {
+      if (this->len < this->size)
+        memcpy(this->buf + this->len, str, n <= this->size - this->len ? n : this->size - this->len);
+      this->len += n;
+    }
+
+    // Unsigned LEB128: 7 bits per byte, least significant first, with
+    // the top bit set on all but the last byte
+    void put_varint(uint32_t v)
+    {
+      while (v >= 0x80)
+      {
+        this->put(v | 0x80);
+        v >>= 7;
+      }
+      this->put(v);
+    }
+  };
+
+  /**
+   * Reads bytes written by BinaryWriter. On the first error, err is set
+   * to its code and pos points to where the error occurred, after which all reads
+   * fail.
+   */
+  struct BinaryReader
+  {
+    const uint8_t *pos;
+    const uint8_t *end;
+    ParseError err;
+
+    BinaryReader(const uint8_t *buf, size_t len) : pos(buf), end(buf + len), err(ParseError::NONE) {}
+
+    bool failed() const { return this->err != ParseError::NONE; }
+
+    bool fail(ParseError err)
+    {
+      if (!this->failed())
+        this->err = err;
+      return false;
+    }
+
+    bool get(uint8_t &b)
+    {
+      if (this->failed() || this->pos == this->end)
+        return this->fail(ParseError::TRUNCATED_DATA);
+      b = *this->pos++;
+      return true;
+    }
+
+    bool get_bytes(const char *&str, size_t n)
+    {
+      if (this->failed() || (size_t)(this->end - this->pos) < n)
+        return this->fail(ParseError::TRUNCATED_DATA);
+      str = (const char *)this->pos;
+      this->pos += n;
+      return true;
+    }
+
+    bool get_varint(uint32_t &v)
+    {
+      v = 0;
+      for (uint8_t shift = 0; shift < 35; shift += 7)
+      {
+        uint8_t b;
+        if (!this->get(b))
+          return false;
+        // The fifth byte can only hold the top 4 bits
+        if (shift == 28 && b > 0x0f)
+          return this->fail(ParseError::VALUE_OUT_OF_RANGE);
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+          return true;
+      }
+      return this->fail(ParseError::VALUE_OUT_OF_RANGE);
+    }
+  };
+
+  /**
+   * Encoding of the value types used by the fields: integers and
+   * FixedValues (which are integers in thousands) as a varint, strings
+   * as their length (varint) followed by their characters, and
+   * TimestampedFixedValue as the timestamp string followed by the value.
+   */
+  inline void _encode_value(BinaryWriter &w, uint32_t v) { w.put_varint(v); }
+  inline void _encode_value(BinaryWriter &w, const FixedValue &v) { w.put_varint(v._value); }
+
+  inline void _encode_string(BinaryWriter &w, const char *str, size_t n)
+  {
+    w.put_varint(n);
+    w.put_bytes(str, n);
+  }
+
+  inline void _encode_value(BinaryWriter &w, const String &s) { _encode_string(w, s.c_str(), s.length()); }
+  inline void _encode_value(BinaryWriter &w, const StringView &s) { _encode_string(w, s.data(), s.length()); }
+
+  template <size_t N>
+  inline void _encode_value(BinaryWriter &w, const FixedString<N> &s)
+  {
+    _encode_string(w, s.c_str(), s.length());
+  }
+
+  inline void _encode_value(BinaryWriter &w, const TimestampedFixedValue &v)
+  {
+    _encode_value(w, v.timestamp);
+    w.put_varint(v._value);
+  }
+
+  inline bool _decode_value(BinaryReader &r, uint32_t &v) { return r.get_varint(v); }
+
+  template <typename I>
+  inline bool _decode_int(BinaryReader &r, I &v, uint32_t max)
+  {
+    uint32_t tmp;
+    if (!r.get_varint(tmp))
+      return false;
+    if (tmp > max)
+      return r.fail(ParseError::VALUE_OUT_OF_RANGE);
+    v = tmp;
+    return true;
+  }
+
+  inline bool _decode_value(BinaryReader &r, uint16_t &v) { return _decode_int(r, v, 0xffff); }
+  inline bool _decode_value(BinaryReader &r, uint8_t &v) { return _decode_int(r, v, 0xff); }
+  inline bool _decode_value(BinaryReader &r, FixedValue &v) { return r.get_varint(v._value); }
+
+  // With DSMR_STRING_VIEW, the decoded strings point into the encoded
+  // data
+  template <typename S>
+  inline bool _decode_string(BinaryReader &r, S &s)
+  {
+    uint32_t n;
+    const char *str;
+    if (!r.get_varint(n) || !r.get_bytes(str, n))
+      return false;
+    if (!assign_string(s, str, n))
+      return r.fail(ParseError::INVALID_STRING_LENGTH);
+    return true;
+  }
+
+  inline bool _decode_value(BinaryReader &r, String &s) { return _decode_string(r, s); }
+  inline bool _decode_value(BinaryReader &r, StringView &s) { return _decode_string(r, s); }
+
+  template <size_t N>
+  inline bool _decode_value(BinaryReader &r, FixedString<N> &s)
+  {
+    return _decode_string(r, s);
+  }
+
+  inline bool _decode_value(BinaryReader &r, TimestampedFixedValue &v)
+  {
+    return _decode_value(r, v.timestamp) && r.get_varint(v._value);
+  }
+
+  /**
+   * Delta coding of a value against the previous value of the same
+   * field: numbers as the difference (zigzag encoded, so small negative
+   * differences are small too), strings as the length of the prefix
+   * shared with the previous value followed by the rest of the string
+   * (length prefixed).
+   */
+  inline uint32_t _zigzag(uint32_t delta) { return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31); }
+  inline uint32_t _unzigzag(uint32_t v) { return (v >> 1) ^ (0 - (v & 1)); }
+
+  inline const char *_string_data(const String &s) { return s.c_str(); }
+  inline const char *_string_data(const StringView &s) { return s.data(); }
+  template <size_t N>
+  inline const char *_string_data(const FixedString<N> &s) { return s.c_str(); }
+
+  inline bool _equal_value(uint32_t a, uint32_t b) { return a == b; }
+  inline bool _equal_value(const FixedValue &a, const FixedValue &b) { return a._value == b._value; }
+
+  template <typename S>
+  inline bool _equal_string(const S &a, const S &b)
+  {
+    return a.length() == b.length() && !memcmp(_string_data(a), _string_data(b), a.length());
+  }
+
+  inline bool _equal_value(const String &a, const String &b) { return _equal_string(a, b); }
+  inline bool _equal_value(const StringView &a, const StringView &b) { return _equal_string(a, b); }
+  template <size_t N>
+  inline bool _equal_value(const FixedString<N> &a, const FixedString<N> &b) { return _equal_string(a, b); }
+
+  inline bool _equal_value(const TimestampedFixedValue &a, const TimestampedFixedValue &b)
+  {
+    return a._value == b._value && _equal_value(a.timestamp, b.timestamp);
+  }
+
+  inline void _encode_delta(BinaryWriter &w, uint32_t prev, uint32_t v) { w.put_varint(_zigzag(v - prev)); }
+  inline void _encode_delta(BinaryWriter &w, const FixedValue &prev, const FixedValue &v)
+  {
+    w.put_varint(_zigzag(v._value - prev._value));
+  }
+
+  template <typename S>
+  inline void _encode_string_delta(BinaryWriter &w, const S &prev, const S &s)
+  {
+    const char *a = _string_data(prev), *b = _string_data(s);
+    size_t shared = 0;
+    while (shared < prev.length() && shared < s.length() && a[shared] == b[shared])
+      ++shared;
+    w.put_varint(shared);
+    _encode_string(w, b + shared, s.length() - shared);
+  }
+
+  inline void _encode_delta(BinaryWriter &w, const String &prev, const String &s) { _encode_string_delta(w, prev, s); }
+  inline void _encode_delta(BinaryWriter &w, const StringView &prev, const StringView &s)
+  {
+    _encode_string_delta(w, prev, s);
+  }
+  template <size_t N>
+  inline void _encode_delta(BinaryWriter &w, const FixedString<N> &prev, const FixedString<N> &s)
+  {
+    _encode_string_delta(w, prev, s);
+  }
+
+  inline void _encode_delta(BinaryWriter &w, const TimestampedFixedValue &prev, const TimestampedFixedValue &v)
+  {
+    _encode_delta(w, prev.timestamp, v.timestamp);
+    _encode_delta(w, (const FixedValue &)prev, (const FixedValue &)v);
+  }
+
+  inline bool _decode_delta(BinaryReader &r, uint32_t &v)
+  {
+    uint32_t delta;
+    if (!r.get_varint(delta))
+      return false;
+    v += _unzigzag(delta);
+    return true;
+  }
+
+  template <typename I>
+  inline bool _decode_int_delta(BinaryReader &r, I &v, uint32_t max)
+  {
+    uint32_t tmp = v;
+    if (!_decode_delta(r, tmp))
+      return false;
+    if (tmp > max)
+      return r.fail(ParseError::VALUE_OUT_OF_RANGE);
+    v = tmp;
+    return true;
+  }
+
+  inline bool _decode_delta(BinaryReader &r, uint16_t &v) { return _decode_int_delta(r, v, 0xffff); }
+  inline bool _decode_delta(BinaryReader &r, uint8_t &v) { return _decode_int_delta(r, v, 0xff); }
+  inline bool _decode_delta(BinaryReader &r, FixedValue &v) { return _decode_delta(r, v._value); }
+
+  // Reads the shared prefix length and the rest of a delta coded string
+  inline bool _decode_string_delta(BinaryReader &r, size_t prev_len, uint32_t &shared, const char *&str,
+                                   uint32_t &n)
+  {
+    if (!r.get_varint(shared) || !r.get_varint(n) || !r.get_bytes(str, n))
+      return false;
+    if (shared > prev_len)
+      return r.fail(ParseError::INVALID_STRING_LENGTH);
+    return true;
+  }
+
+  inline bool _decode_delta(BinaryReader &r, String &s)
+  {
+    uint32_t shared, n;
+    const char *str;
+    if (!_decode_string_delta(r, s.length(), shared, str, n))
+      return false;
+    s.remove(shared);
+    concat_hack(s, str, n);
+    return true;
+  }
+
+  template <size_t N>
+  inline bool _decode_delta(BinaryReader &r, FixedString<N> &s)
+  {
+    uint32_t shared, n;
+    const char *str;
+    if (!_decode_string_delta(r, s.length(), shared, str, n))
+      return false;
+    if (!s.assign_tail(shared, str, n))
+      return r.fail(ParseError::INVALID_STRING_LENGTH);
+    return true;
+  }
+
+#if DSMR_STRING_STORAGE != DSMR_STRING_VIEW
+  inline bool _decode_delta(BinaryReader &r, TimestampedFixedValue &v)
+  {
+    return _decode_delta(r, v.timestamp) && _decode_delta(r, (FixedValue &)v);
+  }
+#endif
+
+  // FNV-1a over the six bytes of an OBIS key, most significant first
+  constexpr uint32_t _fnv1a_key(uint32_t hash, uint64_t key, int8_t shift = 40)
+  {
+    return shift < 0 ? hash : _fnv1a_key((hash ^ (uint8_t)(key >> shift)) * 16777619u, key, shift - 8);
+  }
+
+  // FNV-1a over the OBIS ids of a list of fields, at compile time
+  template <typename... Ts>
+  struct _SchemaHash;
+
+  template <>
+  struct _SchemaHash<>
+  {
+    static constexpr uint32_t value(uint32_t hash) { return hash; }
+  };
+
+  template <typename T, typename... Ts>
+  struct _SchemaHash<T, Ts...>
+  {
+    static constexpr uint32_t value(uint32_t hash) { return _SchemaHash<Ts...>::value(_fnv1a_key(hash, T::id.key())); }
+  };
+
+  /**
+   * Encodes and decodes ParsedData in a compact binary format:
+   *  - A 32-bit hash (little-endian) of the OBIS ids of all fields in the
+   *    ParsedData type, in order. Decoding checks this, so data is never
+   *    decoded into a ParsedData with different fields.
+   *  - A bitmap of the present fields, one bit per field (in the order
+   *    of the ParsedData type, least significant bit first).
+   *  - The value of each present field, in order (see _encode_value).
+   *
+   * For example, the MyData from the README (identification and
+   * power_delivered) takes 23 bytes for the KFM5KAIFA example message:
+   * 4 (hash) + 1 (bitmap) + 1 + 15 (identification) + 2 (0.333 kW).
+   */
+  struct BinaryCodec
+  {
+    /**
+     * Encode the data into buf. Returns the size of the encoded data.
+     * When this is more than size, buf was too small and contains only
+     * part of the data (passing a NULL buf with size 0 can be used to
+     * find out the size needed).
+     */
+    template <typename... Ts>
+    static size_t encode(ParsedData<Ts...> *data, uint8_t *buf, size_t size)
+    {
+      BinaryWriter w(buf, size);
+      put_header(w, data);
+      Encoder encoder = {&w};
+      data->applyEach(encoder);
+      return w.len;
+    }
+
+    /**
+     * Decode data encoded by encode() for the same ParsedData type.
+     * Fields not present in the encoded data have their present flag
+     * cleared. On success, .next points just after the encoded data.
+     * When the fields differ (DIFFERENT_FIELDS), data is not changed.
+     * On other errors, the values of some fields may have been
+     * overwritten, so no field is marked present.
+     */
+    template <typename... Ts>
+    static ParseResult<void> decode(ParsedData<Ts...> *data, const uint8_t *buf, size_t len)
+    {
+      static_assert(sizeof...(Ts) > 0, "ParsedData without fields");
+      ParseResult<void> res;
+      BinaryReader r(buf, len);
+
+      if (!check_hash(r, data))
+        return res.fail(ParseError::DIFFERENT_FIELDS, (const char *)buf);
+
+      // Values are decoded using the encoded present bits, which are only
+      // copied into data when all values were decoded
+      const char *bits;
+      if (r.get_bytes(bits, (sizeof...(Ts) + 7) / 8))
+      {
+        Decoder decoder = {&r, (const uint8_t *)bits, 0};
+        data->applyEach(decoder);
+      }
+
+      if (r.failed())
+      {
+        memset(data->_present, 0, (sizeof...(Ts) + 7) / 8);
+        return res.fail(r.err, (const char *)r.pos);
+      }
+
+      // The present bits use the same format, but make sure the unused
+      // bits in the last byte stay clear
+      memcpy(data->_present, bits, (sizeof...(Ts) + 7) / 8);
+      if (sizeof...(Ts) % 8)
+        data->_present[sizeof...(Ts) / 8] &= (1 << (sizeof...(Ts) % 8)) - 1;
+      return res.until((const char *)r.pos);
+    }
+
+    /**
+     * Encode data as the difference from prev, which must be the data
+     * that was encoded before (with encode() or encode_delta()). Only the
+     * fields that changed are written: the format is the same hash as
+     * for encode(), a bitmap of the fields that changed, one bit for each
+     * changed field telling whether it is present now, and then the
+     * values of the changed fields that are present, delta coded against
+     * their previous value when that was present (see _encode_delta).
+     * Returns the size, like encode().
+     */
+    template <typename... Ts>
+    static size_t encode_delta(ParsedData<Ts...> *prev, ParsedData<Ts...> *data, uint8_t *buf, size_t size)
+    {
+      typedef ParsedData<Ts...> Data;
+      BinaryWriter w(buf, size);
+      put_hash(w, data);
+
+      uint8_t changed[(sizeof...(Ts) + 7) / 8] = {};
+      uint8_t present[(sizeof...(Ts) + 7) / 8] = {};
+      DeltaBits<Data> bits = {prev, changed, present, 0, 0};
+      data->applyEach(bits);
+      w.put_bytes((const char *)changed, sizeof(changed));
+      w.put_bytes((const char *)present, (bits.changed_count + 7) / 8);
+
+      DeltaEncoder<Data> encoder = {&w, prev, changed, 0};
+      data->applyEach(encoder);
+      return w.len;
+    }
+
+    /**
+     * Decode data encoded by encode_delta(). data must contain the
+     * previous data (i.e. what was passed as prev to encode_delta()) and
+     * is updated in place. On errors, data is left partially updated, so
+     * it should not be used as the base for further deltas.
+     */
+    template <typename... Ts>
+    static ParseResult<void> decode_delta(ParsedData<Ts...> *data, const uint8_t *buf, size_t len)
+    {
+      static_assert(DSMR_STRING_STORAGE != DSMR_STRING_VIEW || sizeof...(Ts) == 0,
+                    "Delta decoding needs to modify strings, which is not possible with DSMR_STRING_VIEW");
+      ParseResult<void> res;
+      BinaryReader r(buf, len);
+      if (!check_hash(r, data))
+        return res.fail(ParseError::DIFFERENT_FIELDS, (const char *)buf);
+
+      const char *changed = NULL, *present = NULL;
+      size_t changed_count = 0;
+      if (r.get_bytes(changed, (sizeof...(Ts) + 7) / 8))
+      {
+        for (size_t i = 0; i < (sizeof...(Ts) + 7) / 8; ++i)
+          for (uint8_t b = changed[i]; b; b &= b - 1)
+            changed_count++;
+        r.get_bytes(present, (changed_count + 7) / 8);
+      }
+      if (!r.failed())
+      {
+        DeltaDecoder decoder = {&r, (const uint8_t *)changed, (const uint8_t *)present, 0, 0};
+        data->applyEach(decoder);
+      }
+
+      if (r.failed())
+        return res.fail(r.err, (const char *)r.pos);
+      return res.until((const char *)r.pos);
+    }
+
+    /**
+     * Returns the hash of the OBIS ids of the fields of the ParsedData
+     * type (FNV-1a over the six bytes of each id). This is a constant,
+     * computed at compile time.
+     */
+    template <typename... Ts>
+    static constexpr uint32_t schema_hash(ParsedData<Ts...> *)
+    {
+      return _SchemaHash<Ts...>::value(2166136261u);
+    }
+
+  protected:
+    template <typename... Ts>
+    static void put_hash(BinaryWriter &w, ParsedData<Ts...> *data)
+    {
+      uint32_t hash = schema_hash(data);
+      for (uint8_t i = 0; i < 4; ++i)
+        w.put(hash >> (8 * i));
+    }
+
+    template <typename... Ts>
+    static bool check_hash(BinaryReader &r, ParsedData<Ts...> *data)
+    {
+      uint8_t header[4];
+      for (uint8_t i = 0; i < sizeof(header); ++i)
+        r.get(header[i]);
+      uint32_t hash = header[0] | (uint32_t)header[1] << 8 | (uint32_t)header[2] << 16 | (uint32_t)header[3] << 24;
+      return r.failed() || hash == schema_hash(data);
+    }
+
+    template <typename... Ts>
+    static void put_header(BinaryWriter &w, ParsedData<Ts...> *data)
+    {
+      put_hash(w, data);
+      w.put_bytes((const char *)data->_present, (sizeof...(Ts) + 7) / 8);
+    }
+
+    struct Encoder
+    {
+      BinaryWriter *w;
+
+      template <typename Item>
+      void apply(Item &i, bool present)
+      {
+        if (present)
+          _encode_value(*this->w, i.val());
+      }
+    };
+
+    struct Decoder
+    {
+      BinaryReader *r;
+      // The present bits from the encoded data
+      const uint8_t *present;
+      size_t index;
+
+      template <typename Item>
+      void apply(Item &i, bool)
+      {
+        bool present = this->present[this->index / 8] & (1 << (this->index % 8));
+        this->index++;
+        if (present && !this->r->failed())
+          _decode_value(*this->r, i.val());
+      }
+    };
+
+    template <typename Data>
+    struct DeltaBits
+    {
+      Data *prev;
+      uint8_t *changed;
+      uint8_t *present;
+      size_t index;
+      size_t changed_count;
+
+      template <typename Item>
+      void apply(Item &i, bool present)
+      {
+        Item &p = *static_cast<Item *>(this->prev);
+        bool was_present = this->prev->template present<Item>();
+        if (present != was_present || (present && !_equal_value(i.val(), p.val())))
+        {
+          this->changed[this->index / 8] |= 1 << (this->index % 8);
+          if (present)
+            this->present[this->changed_count / 8] |= 1 << (this->changed_count % 8);
+          this->changed_count++;
+        }
+        this->index++;
+      }
+    };
+
+    template <typename Data>
+    struct DeltaEncoder
+    {
+      BinaryWriter *w;
+      Data *prev;
+      const uint8_t *changed;
+      size_t index;
+
+      template <typename Item>
+      void apply(Item &i, bool present)
+      {
+        Item &p = *static_cast<Item *>(this->prev);
+        if (this->changed[this->index / 8] & (1 << (this->index % 8)) && present)
+        {
+          if (this->prev->template present<Item>())
+            _encode_delta(*this->w, p.val(), i.val());
+          else
+            _encode_value(*this->w, i.val());
+        }
+        this->index++;
+      }
+    };
+
+    struct DeltaDecoder
+    {
+      BinaryReader *r;
+      const uint8_t *changed;
+      const uint8_t *present;
+      size_t index;
+      size_t changed_count;
+
+      template <typename Item>
+      void apply(Item &i, PresentBit present)
+      {
+        bool changed = this->changed[this->index / 8] & (1 << (this->index % 8));
+        this->index++;
+        if (!changed || this->r->failed())
+          return;
+
+        bool was_present = present;
+        present = this->present[this->changed_count / 8] & (1 << (this->changed_count % 8));
+        this->changed_count++;
+        if (present)
+        {
+          if (was_present)
+            _decode_delta(*this->r, i.val());
+          else
+            _decode_value(*this->r, i.val());
+        }
+      }
+    };
+  };
+
+} // namespace dsmr
+
+#endif // DSMR_INCLUDE_SERIALIZE_H
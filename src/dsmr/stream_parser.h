@@ -0,0 +1,319 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Streaming P1 parser, that parses a message while its bytes arrive,
+ * without buffering the complete message.
+ */
+
+#ifndef DSMR_INCLUDE_STREAM_PARSER_H
+#define DSMR_INCLUDE_STREAM_PARSER_H
+
+#include "crc16.h"
+#include "parser.h"
+
+namespace dsmr
+{
+
+  /**
+ * Push-style parser that consumes a P1 message byte by byte (or in
+ * chunks), as it is received. Every line is parsed into the fields of
+ * Data as soon as it is complete, and the CRC is updated along the way,
+ * so only a single line is ever buffered (at most max_line_len bytes).
+ *
+ * Fields are parsed into a staging copy of Data. Only when the checksum
+ * of the message matches, the staging copy is committed and returned by
+ * data(); a message with a parse error or a wrong checksum never
+ * changes data(). Staging and committed copies are swapped, not copied,
+ * so this needs memory for two Data objects.
+ *
+ * After a line fails to parse, the rest of the message is only
+ * checksummed. Like P1Parser::parse, a wrong checksum is reported
+ * instead of the line error, since the error is likely caused by the
+ * corruption.
+ *
+ * Lines longer than max_line_len are an error, unless their OBIS id is
+ * not one of the fields in Data (then the rest of the line is skipped
+ * without buffering it). Make sure max_line_len covers the longest
+ * field you use (e.g. message_long can be over 2048 bytes).
+ *
+ * Since the line buffer is reused, this cannot be used with
+ * DSMR_STRING_VIEW.
+ *
+ *   P1StreamParser<MyData> parser;
+ *
+ *   void loop() {
+ *     if (parser.loop(&Serial1))
+ *       print(parser.data());
+ *   }
+ */
+  template <typename Data, size_t max_line_len = 256>
+  class P1StreamParser
+  {
+#if DSMR_STRING_STORAGE == DSMR_STRING_VIEW
+    static_assert(sizeof(Data) == 0, "P1StreamParser cannot be used with DSMR_STRING_VIEW");
+#endif
+
+  public:
+    /**
+     * Create a new parser. When unknown_error is true, lines for fields
+     * not in Data are an error (see P1Parser::parse).
+     */
+    P1StreamParser(bool unknown_error = false)
+        : unknown_error(unknown_error), state(State::WAITING_STATE), committed(0), _available(false)
+    {
+    }
+
+    /**
+     * Process a single byte. Returns true when this byte completed a
+     * correct message, which is then available through data().
+     */
+    bool feed(char c)
+    {
+      switch (this->state)
+      {
+      case State::WAITING_STATE:
+        if (c == '/')
+          this->start();
+        return false;
+
+      case State::DATA_STATE:
+        if (this->line_failed && c != '!')
+        {
+          this->update_crc(&c, 1);
+        }
+        else if (c == '\r' || c == '\n')
+        {
+          this->update_crc(&c, 1);
+          this->end_line();
+        }
+        else if (c == '!')
+        {
+          this->update_crc(&c, 1);
+          if (this->line_len && !this->line_failed)
+            this->fail_line(ParseResult<void>().fail(ParseError::LINE_NOT_TERMINATED, this->line + this->line_len));
+          this->state = State::CHECKSUM_STATE;
+          this->crc_len = 0;
+        }
+        else if (this->line_len < max_line_len)
+        {
+          this->line[this->line_len++] = c;
+        }
+        else
+        {
+          // Line too long, keep the start of the line (for its OBIS id)
+          // and just checksum the rest
+          this->update_crc(&c, 1);
+          this->overflow = true;
+        }
+        return false;
+
+      case State::CHECKSUM_STATE:
+        this->crc_buf[this->crc_len++] = c;
+        if (this->crc_len < CrcParser::CRC_LEN)
+          return false;
+        return this->end_message();
+      }
+      return false;
+    }
+
+    /**
+     * Process n bytes. Returns true when a correct message was completed
+     * (if more than one was completed, data() has the last one).
+     */
+    bool feed(const char *buf, size_t n)
+    {
+      bool complete = false;
+      while (n--)
+        complete |= this->feed(*buf++);
+      return complete;
+    }
+
+    /**
+     * Process all bytes available on the stream, until a message is
+     * complete. Returns true when a correct message was completed.
+     */
+    bool loop(Stream *stream)
+    {
+      int c;
+      while ((c = stream->read()) >= 0)
+      {
+        if (this->feed((char)c))
+          return true;
+      }
+      return false;
+    }
+
+    /**
+     * Returns true when a correct message was committed, until clear()
+     * is called.
+     */
+    bool available() const { return this->_available; }
+
+    /**
+     * Mark the committed message as processed.
+     */
+    void clear() { this->_available = false; }
+
+    /**
+     * The fields of the last correct message.
+     */
+    Data &data() { return this->slots[this->committed]; }
+
+    /**
+     * The result of the last (or current) message. When parsing failed,
+     * err is set. The ctx pointer points into the line buffer, which
+     * stays valid until the next message starts. A line error is set as
+     * soon as the line is complete, but can still be replaced by a
+     * checksum error when the message ends.
+     */
+    const ParseResult<void> &result() const { return this->res; }
+
+    /**
+     * Returns the error of the last message in a fancy multi-line format,
+     * see ParseResult::fullError.
+     */
+    String fullError() const { return this->res.fullError(this->line, this->line + this->line_len); }
+
+    /**
+     * Prints the same as fullError() to out, without allocating.
+     */
+    size_t printFullError(Print &out) const { return this->res.printFullError(out, this->line, this->line + this->line_len); }
+
+  protected:
+    enum class State : uint8_t
+    {
+      WAITING_STATE,
+      DATA_STATE,
+      CHECKSUM_STATE,
+    };
+
+    Data &staging() { return this->slots[this->committed ^ 1]; }
+
+    void start()
+    {
+      this->state = State::DATA_STATE;
+      // Include the / in the CRC
+      this->crc = _crc16_update(0, '/');
+      this->res = ParseResult<void>();
+      this->staging() = Data();
+      this->first_line = true;
+      this->line_failed = false;
+      this->reset_line();
+    }
+
+    void reset_line()
+    {
+      this->line_len = 0;
+      this->crc_pos = 0;
+      this->overflow = false;
+    }
+
+    // Add bytes to the CRC that come after the (buffered) line so far
+    void update_crc(const char *buf, size_t n)
+    {
+      this->crc = crc16_update(this->crc, this->line + this->crc_pos, this->line_len - this->crc_pos);
+      this->crc_pos = this->line_len;
+      this->crc = crc16_update(this->crc, buf, n);
+    }
+
+    void end_line()
+    {
+      const char *line = this->line, *end = this->line + this->line_len;
+      ParseResult<void> tmp;
+      if (this->overflow)
+      {
+        ParseResult<uint64_t> id = ObisIdParser::parse_key(line, end);
+        if (this->first_line || id.err || Data::has_field(id.result) || this->unknown_error)
+          tmp.fail(ParseError::LINE_TOO_LONG, line);
+      }
+      else if (this->first_line)
+      {
+        tmp = P1Parser::parse_identification(&this->staging(), line, end);
+      }
+      else
+      {
+        tmp = P1Parser::parse_line(&this->staging(), line, end, this->unknown_error);
+      }
+
+      if (tmp.err)
+        return this->fail_line(tmp);
+
+      this->first_line = false;
+      this->reset_line();
+    }
+
+    bool end_message()
+    {
+      this->state = State::WAITING_STATE;
+      ParseResult<uint16_t> check = CrcParser::parse(this->crc_buf, this->crc_buf + CrcParser::CRC_LEN);
+      // A checksum error replaces any line error. Do not keep a context,
+      // crc_buf is not part of the line buffer.
+      if (check.err)
+      {
+        this->res = ParseResult<void>().fail(check.code);
+        return false;
+      }
+      if (check.result != this->crc)
+      {
+        this->res = ParseResult<void>().fail(ParseError::CHECKSUM_MISMATCH);
+        return false;
+      }
+      if (this->line_failed)
+        return false;
+      this->committed ^= 1;
+      this->_available = true;
+      return true;
+    }
+
+    // Keep the first line error, and the line (for fullError()), but
+    // keep checksumming until the end of the message
+    void fail_line(const ParseResult<void> &err)
+    {
+      this->res = err;
+      this->line_failed = true;
+    }
+
+    bool unknown_error;
+    State state;
+    uint8_t committed;
+    bool _available;
+    bool first_line;
+    bool line_failed;
+    bool overflow;
+    uint16_t crc;
+    size_t line_len;
+    size_t crc_pos;
+    uint8_t crc_len;
+    char crc_buf[CrcParser::CRC_LEN];
+    char line[max_line_len];
+    ParseResult<void> res;
+    Data slots[2];
+  };
+
+} // namespace dsmr
+
+#endif // DSMR_INCLUDE_STREAM_PARSER_H
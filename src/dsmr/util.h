@@ -36,6 +36,24 @@
 #define DSMR_PROGMEM PROGMEM
 #endif
 
+// Storage used for the values of string fields (StringField,
+// TimestampField, RawField and TimestampedFixedValue::timestamp):
+//  - DSMR_STRING_ARDUINO: Arduino String, allocated on the heap
+//    (default).
+//  - DSMR_STRING_INLINE: FixedString, a fixed-capacity buffer inside the
+//    field, sized from the field's maximum length. Parsing never
+//    allocates, at the cost of always reserving the maximum length.
+//  - DSMR_STRING_VIEW: StringView, a pointer and length into the buffer
+//    that was parsed. Parsing never copies nor allocates, but the values
+//    are only valid while that buffer is unchanged (see StringView).
+#define DSMR_STRING_ARDUINO 0
+#define DSMR_STRING_INLINE 1
+#define DSMR_STRING_VIEW 2
+
+#ifndef DSMR_STRING_STORAGE
+#define DSMR_STRING_STORAGE DSMR_STRING_ARDUINO
+#endif
+
 #include <Arduino.h>
 
 namespace dsmr
@@ -60,15 +78,135 @@ namespace dsmr
     s.concat(buf);
   }
 
+  /**
+ * String with a fixed capacity of N characters, stored inline (plus
+ * nul-termination).
+ */
+  template <size_t N>
+  struct FixedString
+  {
+    static_assert(N < 65536, "FixedString capacity too large");
+
+    FixedString() : len(0) { buf[0] = '\0'; }
+
+    const char *c_str() const { return buf; }
+    size_t length() const { return len; }
+    static constexpr size_t capacity() { return N; }
+    operator const char *() const { return buf; }
+
+    bool operator==(const char *other) const { return strcmp(buf, other) == 0; }
+    bool operator!=(const char *other) const { return !(*this == other); }
+
+    /**
+   * Replace the contents with the n characters at str. Returns false
+   * (leaving the contents unchanged) when they do not fit.
+   */
+    bool assign(const char *str, size_t n)
+    {
+      if (n > N)
+        return false;
+      memcpy(buf, str, n);
+      buf[n] = '\0';
+      len = n;
+      return true;
+    }
+
+    /**
+   * Keep the first pos characters and append the n characters at str.
+   * Returns false (leaving the contents unchanged) when pos is past the
+   * end, or the result does not fit.
+   */
+    bool assign_tail(size_t pos, const char *str, size_t n)
+    {
+      if (pos > len || n > N - pos)
+        return false;
+      memcpy(buf + pos, str, n);
+      buf[pos + n] = '\0';
+      len = pos + n;
+      return true;
+    }
+
+  protected:
+    char buf[N + 1];
+    uint16_t len;
+  };
+
+  /**
+ * Non-owning reference to length characters at str, which are not
+ * nul-terminated.
+ *
+ * When parsing with DSMR_STRING_VIEW, string values point into the
+ * buffer that was passed to P1Parser::parse (or into the P1Reader
+ * buffer, see P1Reader::parse). They are only valid as long as that
+ * buffer is not modified or freed; copy them out if they need to live
+ * longer.
+ */
+  struct StringView : public Printable
+  {
+    StringView() : str(NULL), len(0) {}
+    StringView(const char *str, size_t len) : str(str), len(len) {}
+
+    const char *data() const { return str; }
+    size_t length() const { return len; }
+
+    bool operator==(const char *other) const { return strlen(other) == len && memcmp(str, other, len) == 0; }
+    bool operator!=(const char *other) const { return !(*this == other); }
+
+    size_t printTo(Print &p) const override { return p.write(str, len); }
+
+  protected:
+    const char *str;
+    size_t len;
+  };
+
+  /**
+ * The type used to store a string field value of at most maxlen
+ * characters, see DSMR_STRING_STORAGE.
+ */
+#if DSMR_STRING_STORAGE == DSMR_STRING_INLINE
+  template <size_t maxlen>
+  using FieldString = FixedString<maxlen>;
+#elif DSMR_STRING_STORAGE == DSMR_STRING_VIEW
+  template <size_t maxlen>
+  using FieldString = StringView;
+#else
+  template <size_t maxlen>
+  using FieldString = String;
+#endif
+
+  /**
+ * Replace the contents of the string s with the n characters at str.
+ * Returns false when they do not fit.
+ */
+  inline bool assign_string(String &s, const char *str, size_t n)
+  {
+    s = "";
+    concat_hack(s, str, n);
+    return true;
+  }
+
+  template <size_t N>
+  inline bool assign_string(FixedString<N> &s, const char *str, size_t n)
+  {
+    return s.assign(str, n);
+  }
+
+  inline bool assign_string(StringView &s, const char *str, size_t n)
+  {
+    s = StringView(str, n);
+    return true;
+  }
+
   /**
  * The ParseResult<T> class wraps the result of a parse function. The type
  * of the result is passed as a template parameter and can be void to
  * not return any result.
  *
  * A ParseResult can either:
- *  - Return an error. In this case, err is set to an error message, ctx
- *    is optionally set to where the error occurred. The result (if any)
- *    and the next pointer are meaningless.
+ *  - Return an error. In this case, err is set to an error message, code
+ *    to the matching ParseError and ctx is optionally set to where the
+ *    error occurred. The result (if any) and the next pointer are
+ *    meaningless.
  *  - Return succesfully. In this case, err and ctx are NULL, result
  *    contains the result (if any) and next points one past the last
  *    byte processed by the parser.
@@ -76,8 +214,9 @@ namespace dsmr
  * The ParseResult class has some convenience functions:
  *  - succeed(result): sets the result to the given value and returns
  *    the ParseResult again.
- *  - fail(err): Set the err member to the error message passed,
- *    optionally sets the ctx and return the ParseResult again.
+ *  - fail(code): Set the code and err members to the error code passed
+ *    and its message, optionally sets the ctx and return the
+ *    ParseResult again. fail(err) does the same for a custom message.
  *  - until(next): Set the next member and return the ParseResult again.
  *
  * Furthermore, ParseResults can be implicitely converted to other
@@ -90,6 +229,151 @@ namespace dsmr
  * probably way longer that needed.
  */
 
+  /**
+ * Compact code for each error that the parser can return, so callers can
+ * check what went wrong without comparing strings. The message for each
+ * code is returned by parse_error_message(). OTHER is used for errors
+ * that were passed as just a message.
+ */
+  enum class ParseError : uint8_t
+  {
+    NONE,
+    OTHER,
+    MISSING_OPEN_PAREN,
+    MISSING_CLOSE_PAREN,
+    INVALID_STRING_LENGTH,
+    INVALID_NUMBER,
+    MISSING_UNIT,
+    INVALID_UNIT,
+    EXTRA_DATA,
+    DUPLICATE_FIELD,
+    OBIS_NUMBER_TOO_LARGE,
+    OBIS_EMPTY,
+    MISSING_START,
+    NO_CHECKSUM,
+    MALFORMED_CHECKSUM,
+    CHECKSUM_MISMATCH,
+    LINE_NOT_TERMINATED,
+    INVALID_IDENTIFICATION,
+    TRAILING_CHARACTERS,
+    UNKNOWN_FIELD,
+    LINE_TOO_LONG,
+    DIFFERENT_FIELDS,
+    TRUNCATED_DATA,
+    VALUE_OUT_OF_RANGE,
+    NO_MESSAGE,
+  };
+
+  /**
+ * Returns the message for an error code (NULL for NONE and OTHER).
+ */
+  inline const __FlashStringHelper *parse_error_message(ParseError code)
+  {
+    switch (code)
+    {
+    case ParseError::NONE:
+    case ParseError::OTHER:
+      return NULL;
+    case ParseError::MISSING_OPEN_PAREN:
+      return F("Missing (");
+    case ParseError::MISSING_CLOSE_PAREN:
+      return F("Missing )");
+    case ParseError::INVALID_STRING_LENGTH:
+      return F("Invalid string length");
+    case ParseError::INVALID_NUMBER:
+      return F("Invalid number");
+    case ParseError::MISSING_UNIT:
+      return F("Missing unit");
+    case ParseError::INVALID_UNIT:
+      return F("Invalid unit");
+    case ParseError::EXTRA_DATA:
+      return F("Extra data");
+    case ParseError::DUPLICATE_FIELD:
+      return F("Duplicate field");
+    case ParseError::OBIS_NUMBER_TOO_LARGE:
+      return F("Obis ID has number over 255");
+    case ParseError::OBIS_EMPTY:
+      return F("OBIS id Empty");
+    case ParseError::MISSING_START:
+      return F("Data should start with /");
+    case ParseError::NO_CHECKSUM:
+      return F("No checksum found");
+    case ParseError::MALFORMED_CHECKSUM:
+      return F("Incomplete or malformed checksum");
+    case ParseError::CHECKSUM_MISMATCH:
+      return F("Checksum mismatch");
+    case ParseError::LINE_NOT_TERMINATED:
+      return F("Last dataline not CRLF terminated");
+    case ParseError::INVALID_IDENTIFICATION:
+      return F("Invalid identification string");
+    case ParseError::TRAILING_CHARACTERS:
+      return F("Trailing characters on data line");
+    case ParseError::UNKNOWN_FIELD:
+      return F("Unknown field");
+    case ParseError::LINE_TOO_LONG:
+      return F("Line too long");
+    case ParseError::DIFFERENT_FIELDS:
+      return F("Different fields encoded");
+    case ParseError::TRUNCATED_DATA:
+      return F("Truncated data");
+    case ParseError::VALUE_OUT_OF_RANGE:
+      return F("Value out of range");
+    case ParseError::NO_MESSAGE:
+      return F("No complete message");
+    }
+    return NULL;
+  }
+
+  /**
+ * Output for ParseResult::printFullError, that writes into a fixed
+ * buffer (truncating when it is full).
+ */
+  struct _ErrorBufferWriter
+  {
+    char *buf;
+    size_t size;
+    size_t len;
+
+    void write(char c)
+    {
+      if (this->len + 1 < this->size)
+        this->buf[this->len] = c;
+      this->len++;
+    }
+
+    void write(const char *str, size_t n)
+    {
+      while (n--)
+        write(*str++);
+    }
+
+    void write(const __FlashStringHelper *str)
+    {
+      PGM_P p = reinterpret_cast<PGM_P>(str);
+      for (char c; (c = pgm_read_byte(p)); ++p)
+        write(c);
+    }
+  };
+
+  struct _ErrorPrintWriter
+  {
+    Print *out;
+    size_t len;
+
+    void write(char c) { this->len += this->out->write((uint8_t)c); }
+    void write(const char *str, size_t n) { this->len += this->out->write((const uint8_t *)str, n); }
+    void write(const __FlashStringHelper *str) { this->len += this->out->print(str); }
+  };
+
+  struct _ErrorStringWriter
+  {
+    String *out;
+
+    void write(char c) { *this->out += c; }
+    void write(const char *str, size_t n) { concat_hack(*this->out, str, n); }
+    void write(const __FlashStringHelper *str) { *this->out += str; }
+  };
+
   // Superclass for ParseResult so we can specialize for void without
   // having to duplicate all content
   template <typename P, typename T>
@@ -122,11 +406,20 @@ namespace dsmr
     const char *next = NULL;
     const __FlashStringHelper *err = NULL;
     const char *ctx = NULL;
+    ParseError code = ParseError::NONE;
 
+    ParseResult &fail(ParseError code, const char *ctx = NULL)
+    {
+      this->err = parse_error_message(code);
+      this->ctx = ctx;
+      this->code = code;
+      return *this;
+    }
     ParseResult &fail(const __FlashStringHelper *err, const char *ctx = NULL)
     {
       this->err = err;
       this->ctx = ctx;
+      this->code = ParseError::OTHER;
       return *this;
     }
     ParseResult &until(const char *next)
@@ -138,17 +431,58 @@ namespace dsmr
     ParseResult(const ParseResult &other) = default;
 
     template <typename T2>
-    ParseResult(const ParseResult<T2> &other) : next(other.next), err(other.err), ctx(other.ctx) {}
+    ParseResult(const ParseResult<T2> &other) : next(other.next), err(other.err), ctx(other.ctx), code(other.code) {}
 
     /**
    * Returns the error, including context in a fancy multi-line format.
    * The start and end passed are the first and one-past-the-end
    * characters in the total parsed string. These are needed to properly
    * limit the context output.
+   *
+   * This allocates a String, see the other variants below to avoid
+   * that.
    */
     String fullError(const char *start, const char *end) const
     {
       String res;
+      // We can predict the length, so let String allocate memory in
+      // advance
+      res.reserve(fullError(start, end, NULL, 0));
+      _ErrorStringWriter w = {&res};
+      write_full_error(w, start, end);
+      return res;
+    }
+
+    /**
+   * Writes the same as fullError() into buf, truncated to fit size
+   * (including the terminating NUL). Returns the length of the full
+   * message (excluding the NUL), like snprintf. buf can be NULL when
+   * size is 0, to get the length needed.
+   */
+    size_t fullError(const char *start, const char *end, char *buf, size_t size) const
+    {
+      _ErrorBufferWriter w = {buf, size, 0};
+      write_full_error(w, start, end);
+      if (size)
+        buf[w.len < size ? w.len : size - 1] = '\0';
+      return w.len;
+    }
+
+    /**
+   * Prints the same as fullError() to out, e.g. Serial. Returns the
+   * number of bytes written.
+   */
+    size_t printFullError(Print &out, const char *start, const char *end) const
+    {
+      _ErrorPrintWriter w = {&out, 0};
+      write_full_error(w, start, end);
+      return w.len;
+    }
+
+  protected:
+    template <typename Writer>
+    void write_full_error(Writer &w, const char *start, const char *end) const
+    {
       if (this->ctx && start && end)
       {
         // Find the entire line surrounding the context
@@ -159,28 +493,28 @@ namespace dsmr
         while (line_start > start && line_start[-1] != '\r' && line_start[-1] != '\n')
           --line_start;
 
-        // We can now predict the context string length, so let String allocate
-        // memory in advance
-        res.reserve((line_end - line_start) + 2 + (this->ctx - line_start) + 1 + 2);
-
         // Write the line
-        concat_hack(res, line_start, line_end - line_start);
-        res += "\r\n";
+        w.write(line_start, line_end - line_start);
+        w.write("\r\n", 2);
 
         // Write a marker to point out ctx
         while (line_start++ < this->ctx)
-          res += ' ';
-        res += '^';
-        res += "\r\n";
+          w.write(' ');
+        w.write('^');
+        w.write("\r\n", 2);
       }
-      res += this->err;
-      return res;
+      if (this->err)
+        w.write(this->err);
     }
   };
 
   /**
  * An OBIS id is 6 bytes, usually noted as a-b:c.d.e.f. Here we put them
  * in an array for easy parsing.
+ *
+ * The id can also be packed into a single integer key (a in the most
+ * significant used byte, f in the least significant), which makes
+ * equality, ordering and hashing single integer operations.
  */
   struct ObisId
   {
@@ -190,7 +524,20 @@ namespace dsmr
         : v{a, b, c, d, e, f} {};
     constexpr ObisId() : v() {} // Zeroes
 
-    bool operator==(const ObisId &other) const { return memcmp(&v, &other.v, sizeof(v)) == 0; }
+    constexpr uint64_t key() const
+    {
+      return (uint64_t)v[0] << 40 | (uint64_t)v[1] << 32 | (uint32_t)v[2] << 24 | (uint32_t)v[3] << 16 |
+             (uint32_t)v[4] << 8 | v[5];
+    }
+
+    // Inverse of key()
+    static constexpr ObisId from_key(uint64_t key)
+    {
+      return ObisId(key >> 40, key >> 32, key >> 24, key >> 16, key >> 8, key);
+    }
+
+    constexpr bool operator==(const ObisId &other) const { return key() == other.key(); }
+    constexpr bool operator<(const ObisId &other) const { return key() < other.key(); }
   };
 
 } // namespace dsmr
@@ -0,0 +1,753 @@
+/**
+ * Arduino DSMR parser.
+ *
+ * This software is licensed under the MIT License.
+ *
+ * Copyright (c) 2015 Matthijs Kooijman <matthijs@stdin.nl>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Differential tests, run on a host: each fast path in the library is
+ * compared against a simple reference implementation (or the slower
+ * path it replaces), on the telegrams in bench/corpus.h and on randomly
+ * mutated copies of them. BinaryCodec is checked by decoding what it
+ * encoded.
+ *
+ * Usage: dsmr_test_differential [iterations]
+ *
+ * Exits with status 1 when any difference was found.
+ */
+
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "dsmr.h"
+#include "corpus.h"
+
+using namespace dsmr::bench;
+
+using FullData = ParsedData<
+    identification, p1_version, timestamp, equipment_id, energy_delivered_tariff1, energy_delivered_tariff2,
+    energy_returned_tariff1, energy_returned_tariff2, electricity_tariff, power_delivered, power_returned,
+    electricity_threshold, electricity_switch_position, electricity_failures, electricity_long_failures,
+    electricity_failure_log, electricity_sags_l1, electricity_sags_l2, electricity_sags_l3, electricity_swells_l1,
+    electricity_swells_l2, electricity_swells_l3, message_short, message_long, voltage_l1, voltage_l2, voltage_l3,
+    current_l1, current_l2, current_l3, power_delivered_l1, power_delivered_l2, power_delivered_l3,
+    power_returned_l1, power_returned_l2, power_returned_l3, gas_device_type, gas_equipment_id, gas_valve_position,
+    gas_delivered, thermal_device_type, thermal_equipment_id, thermal_valve_position, thermal_delivered,
+    water_device_type, water_equipment_id, water_valve_position, water_delivered, sub_device_type,
+    sub_equipment_id, sub_valve_position, sub_delivered, energy_delivered_lux, energy_returned_lux>;
+
+static size_t checks = 0, failures = 0;
+
+#define CHECK(cond, ...)                    \
+  do                                        \
+  {                                         \
+    ++checks;                               \
+    if (!(cond) && ++failures <= 20)        \
+    {                                       \
+      printf("%s:%d: ", __func__, __LINE__); \
+      printf(__VA_ARGS__);                  \
+      printf("\n");                         \
+    }                                       \
+  } while (0)
+
+static std::mt19937 rng(1);
+
+static std::vector<std::string> telegrams()
+{
+  std::vector<std::string> res;
+  for (const CorpusEntry &entry : corpus)
+    res.push_back(make_telegram(entry.body));
+  return res;
+}
+
+/**
+ * Returns a randomly mutated copy of telegram: a few characters are
+ * replaced by characters that are significant to the parser, deleted or
+ * duplicated. When fix_crc is set, the checksum is recomputed, so the
+ * mutations reach the field parsers instead of failing the checksum.
+ */
+static std::string mutate(const std::string &telegram, bool fix_crc)
+{
+  static const char interesting[] = "()*.:-!/\r\n0123456789abcW";
+  std::string res = telegram;
+  unsigned n = 1 + rng() % 3;
+  for (unsigned i = 0; i < n && res.size() > 2; ++i)
+  {
+    size_t pos = 1 + rng() % (res.size() - 2);
+    switch (rng() % 4)
+    {
+    case 0:
+    case 1:
+      res[pos] = interesting[rng() % (sizeof(interesting) - 1)];
+      break;
+    case 2:
+      res.erase(pos, 1);
+      break;
+    case 3:
+      res.insert(pos, 1, res[pos]);
+      break;
+    }
+  }
+
+  size_t bang = res.rfind('!');
+  if (fix_crc && bang != std::string::npos && bang + 1 + CrcParser::CRC_LEN <= res.size())
+  {
+    char crc[CrcParser::CRC_LEN + 1];
+    snprintf(crc, sizeof(crc), "%04X", crc16_update(0, res.data(), bang + 1));
+    memcpy(&res[bang + 1], crc, CrcParser::CRC_LEN);
+  }
+  return res;
+}
+
+// Returns the encoded fields, to compare two ParsedData
+template <typename Data>
+static std::string encoded(Data *data)
+{
+  uint8_t buf[8192];
+  size_t len = BinaryCodec::encode(data, buf, sizeof(buf));
+  return std::string((const char *)buf, len);
+}
+
+// The bitwise CRC, against all block implementations
+static void test_crc(const std::vector<std::string> &corpus, unsigned iterations)
+{
+  std::vector<std::string> inputs = corpus;
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    std::string s(rng() % 600, '\0');
+    for (char &c : s)
+      c = rng();
+    inputs.push_back(s);
+  }
+
+  for (const std::string &s : inputs)
+  {
+    // Also start at different alignments
+    size_t skip = s.empty() ? 0 : rng() % std::min<size_t>(s.size(), 16);
+    const char *buf = s.data() + skip;
+    size_t len = s.size() - skip;
+    uint16_t init = rng();
+    uint16_t ref = _crc16_update_bitwise(init, buf, len);
+
+    CHECK(_crc16_update_table(init, buf, len) == ref, "table crc differs for length %zu", len);
+#if DSMR_CRC16_IMPL >= DSMR_CRC16_SLICE8
+    CHECK(_crc16_update_slice8(init, buf, len) == ref, "slice8 crc differs for length %zu", len);
+#endif
+#if DSMR_CRC16_IMPL == DSMR_CRC16_CLMUL
+    CHECK(_crc16_update_clmul(init, buf, len) == ref, "clmul crc differs for length %zu", len);
+#endif
+    CHECK(crc16_update(init, buf, len) == ref, "crc16_update differs for length %zu", len);
+
+    // A single byte at a time
+    uint16_t crc = init;
+    for (size_t i = 0; i < len; ++i)
+      crc = _crc16_update(crc, buf[i]);
+    CHECK(crc == ref, "bytewise crc differs for length %zu", len);
+  }
+}
+
+// The sorted dispatch table, against the linear search, for every line
+template <typename... Ts>
+static void check_dispatch(ParsedData<Ts...> *, const std::string &telegram)
+{
+  typedef ParsedData<Ts...> Data;
+  typedef typename _MakeIndexSeq<sizeof...(Ts)>::type Seq;
+
+  const char *p = telegram.data(), *end = p + telegram.size();
+  while (p < end)
+  {
+    const char *line_end = p;
+    while (line_end < end && *line_end != '\r' && *line_end != '\n')
+      ++line_end;
+
+    ParseResult<uint64_t> id = ObisIdParser::parse_key(p, line_end);
+    if (!id.err)
+    {
+      Data linear, sorted;
+      ParseResult<void> a = _LinearDispatch<Data, Ts...>::parse_line(&linear, id.result, id.next, line_end);
+      ParseResult<void> b = _ObisDispatch<Data, Seq, Ts...>::parse_line(&sorted, id.result, id.next, line_end);
+      CHECK(a.code == b.code && a.next == b.next && a.ctx == b.ctx, "dispatch differs for %.*s",
+            (int)(line_end - p), p);
+      // A field that fails to parse is left with an unspecified value
+      if (!a.err)
+        CHECK(encoded(&linear) == encoded(&sorted), "dispatch parsed differently: %.*s", (int)(line_end - p), p);
+      CHECK(Data::has_field(id.result) == (a.next != id.next || a.err), "has_field wrong for %.*s",
+            (int)(line_end - p), p);
+    }
+    p = line_end + 1;
+  }
+}
+
+static void test_dispatch(const std::vector<std::string> &corpus, unsigned iterations)
+{
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    const std::string &telegram = corpus[i % corpus.size()];
+    check_dispatch((FullData *)NULL, i < corpus.size() ? telegram : mutate(telegram, false));
+  }
+}
+
+#if DSMR_LINE_INDEX_SIZE > 0
+// scan_lines (SIMD, when available), against a bytewise loop
+static void check_scan(const char *str, const char *end)
+{
+  // Reference: record terminators until the ! or a full index, and
+  // scan at most 64 kiB
+  uint16_t ends[LineIndex::CAPACITY];
+  size_t count = 0;
+  bool full = false;
+  const char *scan_end = end - str > 0xffff ? str + 0xffff : end;
+  const char *stop = str;
+  for (; stop < scan_end; ++stop)
+  {
+    if (*stop == '!')
+      break;
+    if (*stop == '\r' || *stop == '\n')
+    {
+      if (count == LineIndex::CAPACITY)
+      {
+        full = true;
+        break;
+      }
+      ends[count++] = stop - str;
+    }
+  }
+  if (stop == scan_end && scan_end != end)
+    full = true;
+
+  LineIndex index;
+  const char *res = scan_lines(str, end, &index);
+  CHECK(res == stop && index.stop == stop, "scan stopped at %zd instead of %zd", res - str, stop - str);
+  CHECK(index.count == count && index.full == full, "scan found %u terminators (full %d) instead of %zu (full %d)",
+        index.count, index.full, count, full);
+  CHECK(!memcmp(index.ends, ends, count * sizeof(ends[0])), "scan recorded different terminators");
+
+  uint16_t init = rng(), crc = init;
+  LineIndex crc_index;
+  res = scan_lines(str, end, &crc_index, &crc);
+  CHECK(res == stop && crc_index.count == count && crc_index.full == full &&
+            !memcmp(crc_index.ends, ends, count * sizeof(ends[0])),
+        "scan with crc differs from scan without");
+  CHECK(crc == _crc16_update_bitwise(init, str, stop - str), "scan computed a different crc");
+}
+
+static void test_scan(const std::vector<std::string> &corpus, unsigned iterations)
+{
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    std::string s;
+    if (i % 2)
+    {
+      s = mutate(corpus[i % corpus.size()], false).substr(1);
+    }
+    else
+    {
+      // Random data with terminators in various densities
+      static const char chars[] = "\r\n!aaaaaaaaaaaaa";
+      size_t density = 2 + rng() % (sizeof(chars) - 3);
+      s.resize(rng() % 3000);
+      for (char &c : s)
+        c = chars[rng() % density];
+    }
+    size_t skip = s.empty() ? 0 : rng() % std::min<size_t>(s.size(), 32);
+    check_scan(s.data() + skip, s.data() + s.size());
+  }
+
+  // Over 64 kiB without a !, so the scan stops early
+  std::string big(0x12345, 'a');
+  check_scan(big.data(), big.data() + big.size());
+}
+#endif
+
+// parse_verify_later, against parse
+static void test_verify_later(const std::vector<std::string> &corpus, unsigned iterations)
+{
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    const std::string &telegram = corpus[i % corpus.size()];
+    std::string s = i < corpus.size() ? telegram : mutate(telegram, i % 2);
+    FullData a, b;
+    ParseResult<void> ra = P1Parser::parse(&a, s.data(), s.size());
+    ParseResult<void> rb = P1Parser::parse_verify_later(&b, s.data(), s.size());
+    CHECK(ra.code == rb.code && ra.ctx == rb.ctx && ra.next == rb.next, "parse_verify_later returns %s instead of %s",
+          parse_error_message(rb.code) ? (const char *)parse_error_message(rb.code) : "success",
+          parse_error_message(ra.code) ? (const char *)parse_error_message(ra.code) : "success");
+    if (!ra.err)
+      CHECK(encoded(&a) == encoded(&b), "parse_verify_later parsed differently");
+  }
+}
+
+// Bytewise version of NumParser::parse, without the SWAR digit loop
+static ParseResult<uint32_t> reference_number(size_t max_decimals, const char *unit, const char *str,
+                                              const char *end)
+{
+  ParseResult<uint32_t> res;
+  if (str >= end || *str != '(')
+    return res.fail(ParseError::MISSING_OPEN_PAREN, str);
+
+  const char *p = str + 1;
+  uint32_t value = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+    value = value * 10 + (*p++ - '0');
+  if (p < end && !strchr("*.)", *p))
+    return res.fail(ParseError::INVALID_NUMBER, p);
+
+  if (max_decimals && p < end && *p == '.')
+  {
+    ++p;
+    for (; p < end && max_decimals && !strchr("*)", *p); ++p, --max_decimals)
+    {
+      if (*p < '0' || *p > '9')
+        return res.fail(ParseError::INVALID_NUMBER, p);
+      value = value * 10 + (*p - '0');
+    }
+  }
+  while (max_decimals--)
+    value *= 10;
+
+  size_t unit_len = unit ? strlen(unit) : 0;
+  if (unit_len)
+  {
+    if (p >= end || *p != '*')
+      return res.fail(ParseError::MISSING_UNIT, p);
+    ++p;
+    if ((size_t)(end - p) < unit_len || memcmp(p, unit, unit_len))
+      return res.fail(ParseError::INVALID_UNIT, p);
+    p += unit_len;
+  }
+
+  if (p >= end || *p != ')')
+    return res.fail(ParseError::EXTRA_DATA, p);
+  return res.succeed(value).until(p + 1);
+}
+
+// Returns a random (mostly valid) number value, like (001234.567*kWh)
+static std::string random_number()
+{
+  static const char junk[] = "0123456789.*()aW\0";
+  static const char *const units[] = {"kWh", "V", "m3", "kW"};
+  std::string res = "(";
+  unsigned digits = rng() % 16;
+  for (unsigned i = 0; i < digits; ++i)
+    res += '0' + rng() % 10;
+  if (rng() % 2)
+  {
+    res += '.';
+    digits = rng() % 5;
+    for (unsigned i = 0; i < digits; ++i)
+      res += '0' + rng() % 10;
+  }
+  if (rng() % 2)
+    res += std::string("*") + units[rng() % 4];
+  res += ')';
+  if (rng() % 4 == 0)
+    res[rng() % res.size()] = junk[rng() % (sizeof(junk) - 1)];
+  return res;
+}
+
+static void check_number(const ParseResult<uint32_t> &res, const ParseResult<uint32_t> &ref, const char *str,
+                         const char *variant)
+{
+  CHECK(res.code == ref.code && res.ctx == ref.ctx && res.next == ref.next, "%s on %s: %s instead of %s", variant,
+        str, res.err ? (const char *)res.err : "success", ref.err ? (const char *)ref.err : "success");
+  if (!ref.err)
+    CHECK(res.result == ref.result, "%s on %s: %u instead of %u", variant, str, res.result, ref.result);
+}
+
+// NumParser (SWAR digit parsing), against reference_number
+static void test_numbers(unsigned iterations)
+{
+  static const char *const units[] = {NULL, "", "kWh", "V"};
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    std::string s = random_number();
+    // Parse from a copy of exactly the right size, so reading past the
+    // end is caught by ASan, and sometimes cut it short
+    size_t len = rng() % 4 ? s.size() : rng() % (s.size() + 1);
+    std::vector<char> buf(s.begin(), s.begin() + len);
+    const char *str = buf.data(), *end = str + len;
+
+    size_t decimals = rng() % 4;
+    const char *unit = units[rng() % 4];
+    check_number(NumParser::parse(decimals, unit, str, end), reference_number(decimals, unit, str, end), s.c_str(),
+                 "parse");
+    check_number(NumParser::parse<3, units::kWh>(str, end), reference_number(3, "kWh", str, end), s.c_str(),
+                 "parse<3, kWh>");
+    check_number(NumParser::parse<0, units::V>(str, end), reference_number(0, "V", str, end), s.c_str(),
+                 "parse<0, V>");
+  }
+}
+
+class StringPrint : public Print
+{
+public:
+  std::string out;
+  size_t write(uint8_t c) override
+  {
+    out += (char)c;
+    return 1;
+  }
+};
+
+// The fullError variants and parse_error_message, against the
+// original String based fullError
+static void check_error(const ParseResult<void> &res, const char *start, const char *end)
+{
+  CHECK(!res.err == (res.code == ParseError::NONE), "err is %s for code %d", res.err ? "set" : "not set",
+        (int)res.code);
+  if (res.code != ParseError::OTHER)
+    CHECK(res.err == parse_error_message(res.code), "err differs from the message for code %d", (int)res.code);
+
+  std::string ref;
+  if (res.ctx && start && end)
+  {
+    const char *line_end = res.ctx;
+    while (line_end < end && *line_end != '\r' && *line_end != '\n')
+      ++line_end;
+    const char *line_start = res.ctx;
+    while (line_start > start && line_start[-1] != '\r' && line_start[-1] != '\n')
+      --line_start;
+    ref.append(line_start, line_end);
+    ref += "\r\n";
+    ref.append(res.ctx - line_start, ' ');
+    ref += "^\r\n";
+  }
+  if (res.err)
+    ref += (const char *)res.err;
+
+  String str = res.fullError(start, end);
+  CHECK(std::string(str.c_str(), str.length()) == ref, "fullError() returns a different text");
+
+  size_t size = rng() % (ref.size() + 2);
+  std::vector<char> buf(size + 1, 'x');
+  size_t len = res.fullError(start, end, size ? buf.data() : NULL, size);
+  CHECK(len == ref.size() && (!size || buf.data() == ref.substr(0, size - 1)) && buf[size] == 'x',
+        "fullError() into %zu bytes returns a different text", size);
+
+  StringPrint print;
+  len = res.printFullError(print, start, end);
+  CHECK(len == ref.size() && print.out == ref, "printFullError() prints a different text");
+}
+
+static void test_errors(const std::vector<std::string> &corpus, unsigned iterations)
+{
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    std::string s = mutate(corpus[i % corpus.size()], i % 2);
+    FullData data;
+    ParseResult<void> res = P1Parser::parse(&data, s.data(), s.size(), i % 3 == 0);
+    check_error(res, s.data(), s.data() + s.size());
+  }
+
+  // Every code (OTHER only comes with a message, see below), with and
+  // without a context
+  const char text[] = "1-0:1.8.1(000123.456*kWh)\r\n1-0:1.8.2";
+  for (uint8_t code = 0; code <= (uint8_t)ParseError::NO_MESSAGE; ++code)
+  {
+    if (code == (uint8_t)ParseError::OTHER)
+      continue;
+    for (size_t pos = 0; pos < sizeof(text); pos += 7)
+    {
+      ParseResult<void> res;
+      if (code)
+        res.fail((ParseError)code, text + pos);
+      check_error(res, text, text + sizeof(text) - 1);
+    }
+  }
+  ParseResult<void> other;
+  check_error(other.fail(F("Some message")), NULL, NULL);
+}
+
+// parse_data_step, called until done with a random number of lines per
+// step, against a single parse_data
+static void test_data_step(const std::vector<std::string> &corpus, unsigned iterations)
+{
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    const std::string &telegram = corpus[i % corpus.size()];
+    std::string s = i < corpus.size() ? telegram : mutate(telegram, false);
+    size_t bang = s.find('!', 1);
+    if (bang == std::string::npos)
+      continue;
+    const char *start = s.data() + 1, *end = s.data() + bang;
+    bool unknown_error = i % 3 == 0;
+
+    FullData a, b;
+    ParseResult<void> ra = P1Parser::parse_data(&a, start, end, unknown_error);
+
+    DataCursor cursor;
+    cursor.start(start, end);
+    size_t max_lines = i % 5 ? 1 + rng() % 8 : (size_t)-1;
+    ParseResult<void> rb;
+    unsigned steps = 0;
+    do
+    {
+      rb = P1Parser::parse_data_step(&b, &cursor, max_lines, unknown_error);
+    } while (!rb.err && !cursor.done() && ++steps < s.size());
+
+    CHECK(rb.err || cursor.done(), "parse_data_step did not finish");
+    CHECK(ra.code == rb.code && ra.ctx == rb.ctx, "parse_data_step returns %s instead of %s",
+          rb.err ? (const char *)rb.err : "success", ra.err ? (const char *)ra.err : "success");
+    String ea = ra.fullError(s.data(), s.data() + s.size()), eb = rb.fullError(s.data(), s.data() + s.size());
+    CHECK(ea == eb, "parse_data_step gives a different fullError");
+    if (!ra.err)
+      CHECK(encoded(&a) == encoded(&b), "parse_data_step parsed differently");
+  }
+}
+
+#if DSMR_STRING_STORAGE != DSMR_STRING_VIEW
+// P1StreamParser, fed in random chunks, against parse
+static void test_stream(const std::vector<std::string> &corpus, unsigned iterations)
+{
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    const std::string &telegram = corpus[i % corpus.size()];
+    std::string s = i < corpus.size() ? telegram : mutate(telegram, i % 2);
+    // The stream parser only finishes when it received a checksum
+    size_t bang = s.find('!');
+    if (bang == std::string::npos || bang + 1 + CrcParser::CRC_LEN > s.size())
+      continue;
+    s.resize(bang + 1 + CrcParser::CRC_LEN);
+    bool unknown_error = i % 3 == 0;
+
+    FullData data;
+    ParseResult<void> ra = P1Parser::parse(&data, s.data(), s.size(), unknown_error);
+
+    std::unique_ptr<P1StreamParser<FullData, 2100>> parser(new P1StreamParser<FullData, 2100>(unknown_error));
+    bool complete = false;
+    for (size_t pos = 0; pos < s.size();)
+    {
+      size_t n = std::min<size_t>(1 + rng() % 64, s.size() - pos);
+      complete |= parser->feed(s.data() + pos, n);
+      pos += n;
+    }
+    const ParseResult<void> &rb = parser->result();
+
+    CHECK(complete == !ra.err && ra.code == rb.code, "P1StreamParser returns %s instead of %s",
+          rb.err ? (const char *)rb.err : "success", ra.err ? (const char *)ra.err : "success");
+    // The stream parser shows just the buffered line: without the / for
+    // the identification, without what follows an unterminated line and
+    // nothing for checksum errors
+    if (ra.code != ParseError::INVALID_IDENTIFICATION && ra.code != ParseError::LINE_NOT_TERMINATED &&
+        ra.code != ParseError::MALFORMED_CHECKSUM && ra.code != ParseError::CHECKSUM_MISMATCH)
+    {
+      String ea = ra.fullError(s.data(), s.data() + s.size()), eb = parser->fullError();
+      CHECK(ea == eb, "P1StreamParser gives a different fullError");
+    }
+    if (!ra.err)
+      CHECK(encoded(&data) == encoded(&parser->data()), "P1StreamParser parsed differently");
+  }
+}
+
+#endif
+
+static_assert(BinaryCodec::schema_hash((FullData *)NULL) != 0, "schema_hash is a compile time constant");
+
+// Randomly clears or sets present bits, leaving the values as they are
+template <typename... Ts>
+static void shuffle_present(ParsedData<Ts...> *data)
+{
+  for (size_t i = 0; i < (sizeof...(Ts) + 7) / 8; ++i)
+    data->_present[i] ^= rng() & rng();
+  if (sizeof...(Ts) % 8)
+    data->_present[sizeof...(Ts) / 8] &= (1 << (sizeof...(Ts) % 8)) - 1;
+}
+
+// Decodes a copy of exactly len bytes of encoded, so ASan catches reads
+// past the end. The copy is freed on return, so with DSMR_STRING_VIEW
+// the decoded strings cannot be used.
+template <typename Data>
+static ParseResult<void> decode_prefix(Data *data, const std::string &encoded, size_t len, bool delta)
+{
+  std::unique_ptr<uint8_t[]> buf(new uint8_t[len]);
+  memcpy(buf.get(), encoded.data(), len);
+  ParseResult<void> res;
+#if DSMR_STRING_STORAGE != DSMR_STRING_VIEW
+  if (delta)
+    res = BinaryCodec::decode_delta(data, buf.get(), len);
+  else
+#endif
+    res = BinaryCodec::decode(data, buf.get(), len);
+  // Make .next comparable after buf is gone
+  if (res.next)
+    res.next = encoded.data() + (res.next - (const char *)buf.get());
+  return res;
+}
+
+// Encodes data as a delta against prev, and checks that decoding that
+// into prev gives data
+template <typename Data>
+static void check_delta(Data *prev, Data *data)
+{
+  uint8_t buf[8192];
+  size_t len = BinaryCodec::encode_delta(prev, data, buf, sizeof(buf));
+  std::string delta((const char *)buf, len);
+  Data decoded = *prev;
+  ParseResult<void> res = decode_prefix(&decoded, delta, len, true);
+  CHECK(!res.err && res.next == delta.data() + len, "decode_delta fails: %s",
+        res.err ? (const char *)res.err : "trailing data");
+  CHECK(encoded(&decoded) == encoded(data), "decode_delta gives different fields");
+
+  Data truncated = *prev;
+  res = decode_prefix(&truncated, delta, rng() % len, true);
+  CHECK(res.code == ParseError::TRUNCATED_DATA, "decode_delta of truncated data returns %s",
+        res.err ? (const char *)res.err : "success");
+}
+
+using IntData = ParsedData<electricity_failures, current_l1, electricity_switch_position, power_delivered,
+                           equipment_id, gas_delivered>;
+
+// BinaryCodec round trips: encode and encode_delta against decoding
+static void test_codec(const std::vector<std::string> &corpus, unsigned iterations)
+{
+  std::vector<FullData> parsed(corpus.size());
+  for (size_t i = 0; i < corpus.size(); ++i)
+  {
+    ParseResult<void> res = P1Parser::parse(&parsed[i], corpus[i].data(), corpus[i].size());
+    CHECK(!res.err, "corpus telegram %zu does not parse", i);
+
+    // With DSMR_STRING_VIEW, the decoded strings point into buf
+    std::string e = encoded(&parsed[i]);
+    std::vector<uint8_t> buf(e.begin(), e.end());
+    FullData decoded;
+    res = BinaryCodec::decode(&decoded, buf.data(), buf.size());
+    CHECK(!res.err && res.next == (const char *)buf.data() + buf.size(), "decode of telegram %zu fails", i);
+    CHECK(encoded(&decoded) == e, "decode of telegram %zu gives different fields", i);
+
+    for (size_t len = 0; len < e.size(); ++len)
+    {
+      // Starts with all fields present, none are left present on errors
+      FullData truncated = parsed[i];
+      memset(truncated._present, 0xff, sizeof(truncated._present));
+      res = decode_prefix(&truncated, e, len, false);
+      CHECK(res.code == ParseError::TRUNCATED_DATA, "decode of %zu bytes of telegram %zu returns %s", len, i,
+            res.err ? (const char *)res.err : "success");
+      for (size_t j = 0; j < sizeof(truncated._present); ++j)
+        CHECK(!truncated._present[j], "decode of %zu bytes of telegram %zu leaves fields present", len, i);
+    }
+  }
+
+  // Data encoded for different fields (or the same fields in another
+  // order) is rejected
+  ParsedData<identification, power_delivered> a;
+  ParsedData<identification, power_returned> b;
+  ParsedData<power_delivered, identification> c;
+  P1Parser::parse(&a, corpus[0].data(), corpus[0].size());
+  std::string e = encoded(&a);
+  ParseResult<void> res = decode_prefix(&b, e, e.size(), false);
+  CHECK(res.code == ParseError::DIFFERENT_FIELDS, "decode into other fields returns %s",
+        res.err ? (const char *)res.err : "success");
+  res = decode_prefix(&c, e, e.size(), false);
+  CHECK(res.code == ParseError::DIFFERENT_FIELDS, "decode into reordered fields returns %s",
+        res.err ? (const char *)res.err : "success");
+
+#if DSMR_STRING_STORAGE != DSMR_STRING_VIEW
+  uint8_t buf[64];
+  size_t len = BinaryCodec::encode_delta(&a, &a, buf, sizeof(buf));
+  e.assign((const char *)buf, len);
+  res = decode_prefix(&b, e, len, true);
+  CHECK(res.code == ParseError::DIFFERENT_FIELDS, "decode_delta into other fields returns %s",
+        res.err ? (const char *)res.err : "success");
+
+  // Deltas between telegrams, with fields appearing and disappearing
+  for (unsigned i = 0; i < iterations; ++i)
+  {
+    FullData prev = parsed[rng() % parsed.size()], data = parsed[rng() % parsed.size()];
+    shuffle_present(&prev);
+    shuffle_present(&data);
+    check_delta(&prev, &data);
+  }
+
+  // Number deltas of INT32_MIN and INT32_MAX (and around), and string
+  // deltas sharing all, part or none of the previous value
+  static const uint32_t numbers[] = {0, 1, 2, 0x7ffffffe, 0x7fffffff, 0x80000000, 0x80000001, 0xfffffffe, 0xffffffff};
+  static const char *const strings[] = {"", "4530303034", "4530303034303030", "45", "X530303034", "230101120000W"};
+  for (uint32_t x : numbers)
+  {
+    for (uint32_t y : numbers)
+    {
+      IntData prev, data;
+      prev.electricity_failures = x;
+      data.electricity_failures = y;
+      prev.current_l1 = x;
+      data.current_l1 = y;
+      prev.electricity_switch_position = x;
+      data.electricity_switch_position = y;
+      prev.power_delivered._value = x;
+      data.power_delivered._value = y;
+      const char *sx = strings[x % 6], *sy = strings[y % 6];
+      assign_string(prev.equipment_id, sx, strlen(sx));
+      assign_string(data.equipment_id, sy, strlen(sy));
+      assign_string(prev.gas_delivered.timestamp, sy, strlen(sy) % 14);
+      assign_string(data.gas_delivered.timestamp, sx, strlen(sx) % 14);
+      prev.gas_delivered._value = y;
+      data.gas_delivered._value = x;
+      for (unsigned j = 0; j < 4; ++j)
+      {
+        // All present, then random fields absent before, after or both
+        memset(prev._present, j ? 0 : 0xff, sizeof(prev._present));
+        memset(data._present, j ? 0 : 0xff, sizeof(data._present));
+        if (j)
+        {
+          shuffle_present(&prev);
+          shuffle_present(&data);
+        }
+        check_delta(&prev, &data);
+      }
+
+      int32_t delta = y - x;
+      CHECK(_unzigzag(_zigzag(delta)) == (uint32_t)delta, "zigzag of %d does not round trip", delta);
+      CHECK(_zigzag(delta) == (delta < 0 ? 2 * ~(uint32_t)delta + 1 : 2 * (uint32_t)delta),
+            "zigzag of %d is %u", delta, _zigzag(delta));
+    }
+  }
+#endif
+}
+
+int main(int argc, char **argv)
+{
+  unsigned iterations = argc > 1 ? atoi(argv[1]) : 20000;
+  std::vector<std::string> corpus = telegrams();
+
+  test_crc(corpus, iterations);
+  test_dispatch(corpus, iterations);
+#if DSMR_LINE_INDEX_SIZE > 0
+  test_scan(corpus, iterations);
+#endif
+  test_verify_later(corpus, iterations);
+  test_numbers(iterations * 10);
+  test_errors(corpus, iterations);
+  test_data_step(corpus, iterations);
+#if DSMR_STRING_STORAGE != DSMR_STRING_VIEW
+  test_stream(corpus, iterations);
+#endif
+  test_codec(corpus, iterations);
+
+  printf("%zu checks, %zu failures\n", checks, failures);
+  return failures ? 1 : 0;
+}